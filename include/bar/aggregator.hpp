@@ -0,0 +1,236 @@
+#pragma once
+
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include "log.hpp"
+#include "reference/order.hpp"
+#include "reference/container.hpp"
+#include "feed/observer.hpp"
+
+#include "bar.hpp"
+
+namespace toy {
+    namespace bar {
+
+        using reference::order;
+        using reference::trade;
+
+        // dense per instrument index into the series arrays
+        struct slot {
+            using id_type = instrument_id;
+            static id_type const invalid_id = (id_type)-1;
+            id_type id = invalid_id;
+
+            uint32_t idx = 0;
+
+            slot() = default;
+            slot(instrument_id id, uint32_t idx) : id(id), idx(idx) {}
+        };
+
+        // one open bar per instrument, kept as structure of arrays across instruments
+        class series {
+            public:
+                // time: threshold in ns; volume: qty; tick: number of trades
+                series(bar_kind kind, int64_t threshold) : _kind(kind), _threshold(threshold) {}
+
+                auto resize(uint32_t size) {
+                    _start.resize(size, 0);
+                    _open.resize(size, 0.0);
+                    _high.resize(size, 0.0);
+                    _low.resize(size, 0.0);
+                    _close.resize(size, 0.0);
+                    _volume.resize(size, 0);
+                    _notional.resize(size, 0.0);
+                    _count.resize(size, 0);
+                }
+
+                auto on_trade(uint32_t idx, instrument_id iid, int64_t qty, double prc, int64_t now, sink* psink) {
+                    if(bar_kind::time == _kind && _count[idx] && now >= _start[idx] + _threshold) {
+                        emit(idx, iid, now, psink);
+                    }
+
+                    if(!_count[idx]) {
+                        _start[idx] = bar_kind::time == _kind ? now - now % _threshold : now;
+                        _open[idx] = _high[idx] = _low[idx] = prc;
+                    }
+
+                    _high[idx] = std::max(_high[idx], prc);
+                    _low[idx] = std::min(_low[idx], prc);
+                    _close[idx] = prc;
+                    _volume[idx] += qty;
+                    _notional[idx] += qty * prc;
+                    _count[idx] ++;
+
+                    if((bar_kind::volume == _kind && _volume[idx] >= _threshold)
+                            || (bar_kind::tick == _kind && _count[idx] >= _threshold)) {
+                        emit(idx, iid, now, psink);
+                    }
+                }
+
+                auto flush(uint32_t idx, instrument_id iid, int64_t now, sink* psink) {
+                    if(_count[idx]) {
+                        emit(idx, iid, now, psink);
+                    }
+                }
+
+                // emit the time bars over by now, returns when the next open one is over
+                auto expire(std::vector<instrument_id> const& iids, int64_t now, sink* psink) {
+                    auto next = std::numeric_limits<int64_t>::max();
+                    if(bar_kind::time != _kind) {
+                        return next;
+                    }
+
+                    for(auto idx = 0U; idx < iids.size(); idx ++) {
+                        if(!_count[idx]) {
+                            continue;
+                        }
+                        if(now >= _start[idx] + _threshold) {
+                            emit(idx, iids[idx], now, psink);
+                        }
+                        else {
+                            next = std::min(next, _start[idx] + _threshold);
+                        }
+                    }
+                    return next;
+                }
+
+                // when the bar of idx is over, max if it is not a time bar or not open
+                auto end(uint32_t idx) const {
+                    return bar_kind::time == _kind && _count[idx] ? _start[idx] + _threshold
+                        : std::numeric_limits<int64_t>::max();
+                }
+
+            private:
+                auto emit(uint32_t idx, instrument_id iid, int64_t now, sink* psink) -> void {
+                    auto end = bar_kind::time == _kind ? _start[idx] + _threshold : now;
+                    psink->publish({ iid, _kind, _start[idx], end, _open[idx], _high[idx], _low[idx], _close[idx],
+                            _volume[idx], _notional[idx] / _volume[idx], _count[idx] });
+
+                    _volume[idx] = 0;
+                    _notional[idx] = 0.0;
+                    _count[idx] = 0;
+                }
+
+            private:
+                bar_kind const _kind;
+                int64_t const _threshold;
+
+                std::vector<int64_t> _start;
+                std::vector<double> _open;
+                std::vector<double> _high;
+                std::vector<double> _low;
+                std::vector<double> _close;
+                std::vector<int64_t> _volume;
+                std::vector<double> _notional;
+                std::vector<int32_t> _count;
+        };
+
+        class aggregator : public feed::observer {
+            public:
+                // threshold 0 disables the series
+                aggregator(sink* psink, int64_t time_us, int64_t volume, int32_t ticks) : _psink(psink) {
+                    if(time_us > 0) {
+                        _series.emplace_back(bar_kind::time, time_us * 1000);
+                    }
+                    if(volume > 0) {
+                        _series.emplace_back(bar_kind::volume, volume);
+                    }
+                    if(ticks > 0) {
+                        _series.emplace_back(bar_kind::tick, ticks);
+                    }
+                }
+
+                // emit all open bars, call after feeder stopped
+                auto flush() {
+                    auto now = _tape ? _now : clock();
+                    for(auto& s : _series) {
+                        for(auto idx = 0U; idx < _iids.size(); idx ++) {
+                            s.flush(idx, _iids[idx], now, _psink);
+                        }
+                    }
+                }
+
+            private: // feed observer
+                // time bars are over once any event is past their end, or the clock is while the feed is quiet
+                auto add(order const* po) -> void override { advance(time(po->ts)); }
+                auto can(order const* po, int64_t) -> void override { advance(time(po->ts)); }
+                auto amd(order const* po, int64_t) -> void override { advance(time(po->ts)); }
+
+                // tape time only moves with the tape
+                auto idle() -> void override {
+                    if(!_tape) {
+                        advance(clock());
+                    }
+                }
+
+                auto exe(trade const* pt) -> void override {
+                    auto now = time(pt->ts);
+                    advance(now);
+
+                    auto pslot = _slots.find(pt->iid);
+                    if(!pslot) {
+                        pslot = _slots.create(pt->iid, (uint32_t)_iids.size());
+                        if(!pslot) {
+                            TOY_LOG(error, bar, "LOGIC [invalid_bar_iid]", pt);
+                            return;
+                        }
+
+                        _iids.push_back(pt->iid);
+                        for(auto& s : _series) {
+                            s.resize(_iids.size());
+                        }
+                    }
+
+                    for(auto& s : _series) {
+                        s.on_trade(pslot->idx, pt->iid, pt->qty, pt->prc, now, _psink);
+                        _next_end = std::min(_next_end, s.end(pslot->idx));
+                    }
+                }
+
+            private:
+                // ns of the tape once events carry its timestamps, of the steady clock until then
+                auto time(uint64_t ts) -> int64_t {
+                    if(ts) {
+                        _tape = true;
+                        _now = (int64_t)ts * 1000;
+                    }
+                    else if(!_tape) {
+                        _now = clock();
+                    }
+                    return _now;
+                }
+
+                // bars of a window all end together, instruments are walked once per window
+                auto advance(int64_t now) -> void {
+                    if(now < _next_end) {
+                        return;
+                    }
+
+                    _next_end = std::numeric_limits<int64_t>::max();
+                    for(auto& s : _series) {
+                        _next_end = std::min(_next_end, s.expire(_iids, now, _psink));
+                    }
+                }
+
+                static auto clock() -> int64_t {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+
+            private:
+                sink* const _psink;
+
+                bool _tape = false;
+                int64_t _now = 0;
+                int64_t _next_end = std::numeric_limits<int64_t>::max(); // of the first open time bar
+
+                std::vector<series> _series;
+                std::vector<instrument_id> _iids;
+                reference::container<slot> _slots;
+        };
+
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "log.hpp"
+#include "reference/instrument.hpp"
+
+namespace toy {
+    namespace bar {
+
+        using reference::instrument_id;
+
+        enum struct bar_kind : char {
+            time = 'T', volume = 'V', tick = 'K'
+        };
+
+        struct bar {
+            instrument_id iid;
+            bar_kind kind;
+
+            int64_t start; // ns, of the tape when it has timestamps, steady clock otherwise
+            int64_t end;
+
+            double open;
+            double high;
+            double low;
+            double close;
+
+            int64_t volume;
+            double vwap;
+            int32_t count;
+        };
+
+        class sink {
+            public:
+                virtual ~sink() {}
+
+                virtual auto publish(bar const&) -> void = 0;
+        };
+
+        class log_sink : public sink {
+            public:
+                auto publish(bar const& b) -> void override {
+                    TOY_LOG(info, bar, "BAR", b.iid, (char)b.kind, "O", b.open, "H", b.high, "L", b.low, "C", b.close,
+                            "V", b.volume, "VWAP", b.vwap, "N", b.count);
+                }
+        };
+
+    }
+}
@@ -60,6 +60,16 @@ namespace toy {
                 return true;
             }
 
+            auto cast(std::string const& raw, int64_t& val) const {
+                val = std::atoll(raw.c_str());
+                return true;
+            }
+
+            auto cast(std::string const& raw, double& val) const {
+                val = std::atof(raw.c_str());
+                return true;
+            }
+
             auto cast(std::string const& raw, bool& val) const {
                 std::string lower(raw.size(), ' ');
                 std::transform(raw.begin(), raw.end(), lower.begin(), ::tolower);
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "reference/instrument.hpp"
+#include "reference/market.hpp"
+#include "reference/delta.hpp"
+#include "reference/signals.hpp"
+#include "order_book/manager.hpp"
+
+namespace toy {
+
+    namespace feed {
+        class feeder_file;
+        class parse_errors;
+    }
+
+    // settings of the same name as in config.ini
+    struct engine_options {
+        int32_t max_lev = 5;            // order_book_level
+        int32_t interval = 10;          // order_book_interval
+        int32_t tolerance = 10;         // order_book_tolerance
+        bool l3 = false;                // order_book_l3
+        int32_t snapshot = 0;           // order_book_snapshot
+        int64_t conflate_us = 0;        // order_book_conflate_us
+        bool analytics = false;         // order_book_analytics
+        reference::book_storage storage = reference::book_storage::map; // order_book_storage
+        bool tolerant = true;           // feeder_tolerant
+        std::vector<reference::instrument_range> subscription; // feeder_subscription, empty: any instrument
+        std::vector<reference::instrument_spec> instruments; // order_book_instruments, empty: any instrument
+    };
+
+    // a feeder and an order book wired together and driven by the calling thread, for use inside another process.
+    // Engines share no state on the message path, any number of them may run on their own threads at once;
+    // logging levels stay process wide, see log; profiling is switched on process wide and counted per thread,
+    // see profile.
+    class engine : private order_book::listener {
+        public:
+            using snapshot_handler = std::function<void(reference::market const*)>;
+            using delta_handler = std::function<void(reference::market_delta const*)>;
+            using signals_handler = std::function<void(reference::signals const*)>;
+
+            // nullptr if opt is invalid, with the reason logged
+            static auto make(engine_options const& opt) -> engine*;
+
+            ~engine();
+
+            engine(engine const&) = delete;
+            auto operator=(engine const&) = delete;
+
+            // called on the pushing thread for every publish, set before pushing
+            auto on_snapshot(snapshot_handler handler) -> void;
+            auto on_delta(delta_handler handler) -> void;
+            auto on_signals(signals_handler handler) -> void;
+
+            // one line of a tape, false if it was rejected, see last_error
+            auto push(std::string const& line) -> bool;
+
+            // decoded events, checked like tape lines. amd with qty 0 takes the order off the book
+            auto add(int64_t iid, int64_t oid, reference::order_side side, int64_t qty, double prc) -> bool;
+            auto can(int64_t oid, reference::order_side side, int64_t qty, double prc) -> bool;
+            auto amd(int64_t oid, reference::order_side side, int64_t qty, double prc) -> bool;
+            auto exe(int64_t iid, int64_t qty, double prc) -> bool;
+
+            // complete messages of an ITCH-like capture, see feed/itch.hpp; returns the bytes consumed, the rest is
+            // the start of a message to pass again with what follows. last_error is that of the last message
+            auto decode(char const* data, size_t len) -> size_t;
+
+            // every line of a tape file, false if it cannot be opened
+            auto replay(std::string const& pathname) -> bool;
+
+            // every message of a capture file, see decode; false if it cannot be opened or ends inside a message
+            auto replay_capture(std::string const& pathname) -> bool;
+
+            // publish what conflation still holds back
+            auto flush() -> void;
+
+            // why the last pushed line or event was rejected, nullptr if it was not
+            auto last_error() const -> char const*;
+
+            auto errors() const -> feed::parse_errors const&;
+
+            // lines and events dropped by the subscription, see engine_options
+            auto filtered() const -> uint64_t;
+
+            // lines and events pushed or messages decoded so far
+            auto lines() const { return _line_num; }
+
+            // depth, health and L3 queries, on the pushing thread
+            auto book() -> order_book::manager* { return _pbook.get(); }
+
+        private:
+            engine(engine_options const& opt);
+
+            auto publish(reference::market const* pmkt) -> void override;
+            auto publish(reference::market_delta const* pdelta) -> void override;
+            auto publish(reference::signals const* psig) -> void override;
+
+        private:
+            std::unique_ptr<feed::feeder_file> _pfeeder;
+            std::unique_ptr<order_book::manager> _pbook;
+            uint32_t _line_num = 0;
+
+            snapshot_handler _on_snapshot;
+            delta_handler _on_delta;
+            signals_handler _on_signals;
+    };
+
+}
@@ -2,6 +2,7 @@
 
 #include <vector>
 
+#include "thread.hpp"
 #include "observer.hpp"
 
 namespace toy {
@@ -14,10 +15,18 @@ namespace toy {
                 virtual auto start() -> bool = 0;
                 virtual auto stop() -> void = 0;
 
+                // bytes held by feeder containers, safe to call from any thread
+                virtual auto memory() const -> size_t { return 0; }
+
                 auto register_observer(observer* pob) {
                     _observers.push_back(pob);
                 }
 
+                // applied by the feeder thread itself once started
+                auto set_thread_policy(thread_policy const& policy) {
+                    _policy = policy;
+                }
+
             protected:
                 template<typename ... ARGS>
                 auto publish(void (observer::*func)(ARGS ...), ARGS ... args) {
@@ -26,6 +35,9 @@ namespace toy {
                     }
                 }
 
+            protected:
+                thread_policy _policy;
+
             private:
                 std::vector<observer*> _observers;
         };
@@ -16,6 +16,10 @@ namespace toy {
                 virtual auto can(order const*, int64_t) -> void = 0;
                 virtual auto amd(order const*, int64_t) -> void = 0;
                 virtual auto exe(trade const*) -> void = 0;
+
+                // no event for now, called by the thread the observer runs on while it waits for the next one,
+                // so whatever is due by time alone does not wait for the feed
+                virtual auto idle() -> void {}
         };
     }
 }
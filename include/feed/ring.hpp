@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cassert>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "log.hpp"
+#include "thread.hpp"
+#include "observer.hpp"
+
+namespace toy {
+    namespace feed {
+
+        using reference::order_action;
+
+        // single producer, multi consumer ring of decoded events, disruptor style.
+        // Registered as the only observer of a feeder, it copies each event into a pre-allocated slot once;
+        // every attached observer then runs on its own thread and reads the slots in place.
+        // A consumer sees an event only after the consumers it depends on are done with it,
+        // the producer waits whenever the slowest consumer is a full ring behind.
+        class ring : public observer {
+            struct event {
+                order_action act;
+                order ord;
+                trade trd;
+                int64_t qty; // cancelled qty or old book qty
+            };
+
+            public:
+                class consumer {
+                    friend class ring;
+
+                    public:
+                        consumer(consumer const&) = delete;
+                        auto operator=(consumer const&) = delete;
+
+                        auto name() const -> std::string const& { return _name; }
+
+                        // events published but not handled yet, any thread
+                        auto lag() const {
+                            return _pring->_cursor.load(std::memory_order_relaxed) - _seq.load(std::memory_order_relaxed);
+                        }
+                        auto max_lag() const { return _max_lag.load(std::memory_order_relaxed); }
+
+                    private:
+                        consumer(ring* pring, std::string const& name, observer* pob, thread_policy const& policy,
+                                std::vector<consumer const*> const& after)
+                            : _pring(pring), _name(name), _pob(pob), _policy(policy), _after(after) {}
+
+                        // highest sequence this consumer may handle
+                        auto barrier() const {
+                            auto seq = _pring->_cursor.load(std::memory_order_acquire);
+                            for(auto pc : _after) {
+                                seq = std::min(seq, pc->_seq.load(std::memory_order_acquire));
+                            }
+                            return seq;
+                        }
+
+                        auto run() -> void {
+                            _policy.apply(_name);
+
+                            auto idle = 0U;
+                            while(true) {
+                                auto next = _seq.load(std::memory_order_relaxed) + 1;
+                                auto avail = barrier();
+                                if(avail < next) {
+                                    if(_pring->_stopping.load(std::memory_order_acquire)
+                                            && next > _pring->_cursor.load(std::memory_order_acquire)) {
+                                        break;
+                                    }
+                                    _pob->idle();
+                                    ring::wait(idle ++);
+                                    continue;
+                                }
+                                idle = 0;
+
+                                auto lag = _pring->_cursor.load(std::memory_order_relaxed) - next + 1;
+                                if(lag > _max_lag.load(std::memory_order_relaxed)) {
+                                    _max_lag.store(lag, std::memory_order_relaxed);
+                                }
+
+                                for(auto seq = next; seq <= avail; seq ++) {
+                                    dispatch(_pring->_events[seq & _pring->_mask]);
+                                }
+                                _seq.store(avail, std::memory_order_release);
+                            }
+                        }
+
+                        auto dispatch(event const& e) -> void {
+                            switch(e.act) {
+                            case order_action::insert: _pob->add(&e.ord); break;
+                            case order_action::remove: _pob->can(&e.ord, e.qty); break;
+                            case order_action::amend: _pob->amd(&e.ord, e.qty); break;
+                            case order_action::match: _pob->exe(&e.trd); break;
+                            default: break;
+                            }
+                        }
+
+                    private:
+                        std::atomic<int64_t> _seq { -1 }; // last handled
+                        std::atomic<int64_t> _max_lag { 0 };
+
+                        ring* const _pring;
+                        std::string const _name;
+                        observer* const _pob;
+                        thread_policy const _policy;
+                        std::vector<consumer const*> const _after;
+
+                        std::thread _thrd;
+                };
+
+            public:
+                // capacity in events, power of 2
+                ring(uint32_t capacity) : _mask(capacity - 1), _events(capacity) {
+                    assert(capacity && !(capacity & _mask));
+                }
+
+                ~ring() { stop(); }
+
+                // observer runs on its own thread once started, after every consumer in after
+                auto attach(std::string const& name, observer* pob, thread_policy const& policy = thread_policy(),
+                        std::vector<consumer const*> const& after = {}) {
+                    assert(!_started);
+                    _consumers.emplace_back(new consumer(this, name, pob, policy, after));
+                    return (consumer const*)_consumers.back().get();
+                }
+
+                auto consumers() const -> std::vector<std::unique_ptr<consumer>> const& { return _consumers; }
+
+                auto start() {
+                    _started = true;
+                    for(auto& pc : _consumers) {
+                        auto p = pc.get();
+                        pc->_thrd = std::thread([p]() { p->run(); });
+                    }
+                }
+
+                // call once the producer stopped, returns after every consumer handled every event
+                auto stop() -> void {
+                    _stopping.store(true, std::memory_order_release);
+                    for(auto& pc : _consumers) {
+                        if(pc->_thrd.joinable()) {
+                            pc->_thrd.join();
+                            TOY_LOG(info, feed, "ring", pc->name(), "stopped, max lag", pc->max_lag());
+                        }
+                    }
+                }
+
+            private: // feed observer, producer thread
+                auto add(order const* po) -> void override {
+                    auto& e = claim();
+                    e.act = order_action::insert;
+                    e.ord = *po;
+                    commit();
+                }
+
+                auto can(order const* po, int64_t can_qty) -> void override {
+                    auto& e = claim();
+                    e.act = order_action::remove;
+                    e.ord = *po;
+                    e.qty = can_qty;
+                    commit();
+                }
+
+                auto amd(order const* po, int64_t old_book) -> void override {
+                    auto& e = claim();
+                    e.act = order_action::amend;
+                    e.ord = *po;
+                    e.qty = old_book;
+                    commit();
+                }
+
+                auto exe(trade const* pt) -> void override {
+                    auto& e = claim();
+                    e.act = order_action::match;
+                    e.trd = *pt;
+                    commit();
+                }
+
+            private:
+                // spin first, then yield, then sleep, so an idle feed does not burn a core per consumer
+                static auto wait(uint32_t idle) -> void {
+                    if(idle < 64) {
+                        return;
+                    }
+                    if(idle < 4096) {
+                        std::this_thread::yield();
+                        return;
+                    }
+                    std::this_thread::sleep_for(std::chrono::microseconds(50));
+                }
+
+                // slot of the next sequence, once every consumer is done with its previous lap
+                auto claim() -> event& {
+                    auto idle = 0U;
+                    while(_next - _gate > (int64_t)_mask) {
+                        _gate = _next;
+                        for(auto& pc : _consumers) {
+                            _gate = std::min(_gate, pc->_seq.load(std::memory_order_acquire) + 1);
+                        }
+                        if(_next - _gate > (int64_t)_mask) {
+                            wait(idle ++);
+                        }
+                    }
+                    return _events[_next & _mask];
+                }
+
+                auto commit() -> void {
+                    _cursor.store(_next ++, std::memory_order_release);
+                }
+
+            private:
+                int64_t const _mask;
+                std::vector<event> _events;
+                std::vector<std::unique_ptr<consumer>> _consumers;
+                bool _started = false;
+
+                int64_t _next = 0;      // producer only
+                int64_t _gate = 0;      // oldest sequence a consumer may still read, cached by producer
+                std::atomic<int64_t> _cursor { -1 }; // last published
+                std::atomic<bool> _stopping { false };
+        };
+
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <algorithm>
+
+namespace toy {
+
+    // log-linear histogram of non-negative values: 16 linear sub-buckets per power of 2, within ~6%
+    class histogram {
+        static uint32_t const sub_bits = 4;
+        static uint32_t const subs = 1U << sub_bits;
+
+        public:
+            auto record(uint64_t val) {
+                _counts[index(val)] ++;
+                _count ++;
+                if(val > _max) {
+                    _max = val;
+                }
+            }
+
+            auto count() const { return _count; }
+            auto max() const { return _max; }
+
+            // upper bound of the bucket holding the p-th fraction, 0 <= p <= 1
+            auto percentile(double p) const {
+                auto target = (uint64_t)(p * _count);
+                auto seen = 0UL;
+                for(auto i = 0U; i < _counts.size(); i ++) {
+                    seen += _counts[i];
+                    if(seen > target) {
+                        return std::min(upper(i), _max);
+                    }
+                }
+                return _max;
+            }
+
+        private:
+            static auto index(uint64_t val) -> uint32_t {
+                if(val < subs) {
+                    return (uint32_t)val;
+                }
+                auto msb = 63U - (uint32_t)__builtin_clzll(val);
+                auto shift = msb - sub_bits;
+                return (shift + 1) * subs + (uint32_t)((val >> shift) & (subs - 1));
+            }
+
+            static auto upper(uint32_t idx) -> uint64_t {
+                if(idx < subs) {
+                    return idx;
+                }
+                auto shift = idx / subs - 1;
+                return (((uint64_t)(subs + idx % subs) + 1) << shift) - 1;
+            }
+
+        private:
+            std::array<uint64_t, (64 - sub_bits) * subs> _counts {};
+            uint64_t _count = 0;
+            uint64_t _max = 0;
+    };
+
+}
@@ -2,34 +2,52 @@
 
 #include <iostream>
 #include <mutex>
+#include <atomic>
 
 #include "reference/to_string.hpp"
 
+// calls below this severity are compiled out, see TOY_LOG. 0: debug and up, 4: nothing
+#ifndef TOY_LOG_MIN_SEVERITY
+#define TOY_LOG_MIN_SEVERITY 0
+#endif
+
+// log at SEV (debug, info, warn, error) for MOD (general, feed, order_book, reference, bar).
+// Arguments are neither evaluated nor copied unless the module logs at that severity,
+// calls below TOY_LOG_MIN_SEVERITY do not exist in the binary.
+#define TOY_LOG(SEV, MOD, ...) do { \
+        if((int32_t)toy::log::severity::SEV >= TOY_LOG_MIN_SEVERITY \
+                && toy::log::enabled(toy::log::severity::SEV, toy::log::module::MOD)) { \
+            toy::log::write(toy::log::severity::SEV, __VA_ARGS__); \
+        } \
+    } while(0)
+
 namespace toy {
 
     class log {
-        private:
+        public:
             enum struct severity {
                 debug = 0, info, warn, error, MAX
             };
 
+            enum struct module : uint32_t {
+                general = 0, feed, order_book, reference, bar, MAX
+            };
+
         private:
+            static uint32_t const modules = (uint32_t)module::MAX;
+
             log() {}
 
             auto print(std::ostream& s) {
                 s << std::endl;
             }
 
-            template<typename T, typename ... ARGS> auto print(std::ostream& s, T const& t, ARGS ... args) {
+            template<typename T, typename ... ARGS> auto print(std::ostream& s, T const& t, ARGS const& ... args) {
                 s << ' ' << t;
                 print(s, args ...);
             }
 
-            template<typename ... ARGS> auto print(severity sev, ARGS ... args) {
-                if(sev < _severity) {
-                    return;
-                }
-
+            template<typename ... ARGS> auto print(severity sev, ARGS const& ... args) {
                 std::lock_guard<decltype(_mtx)> l(_mtx);
                 switch(sev) {
                     case severity::debug: print(std::cout, "[DEBUG]", args ...); break;
@@ -40,33 +58,73 @@ namespace toy {
                 }
             }
 
+            // modules without a level of their own follow the global one, 4 silences every module
+            auto apply() -> void {
+                auto global = _severity.load(std::memory_order_relaxed);
+                for(auto i = 0U; i < modules; i ++) {
+                    auto own = _own[i].load(std::memory_order_relaxed);
+                    _levels[i].store(severity::MAX == global || own < 0 ? global : (severity)own,
+                            std::memory_order_relaxed);
+                }
+            }
+
         public:
             ~log() {}
 
+            // may be called at any time, e.g. from control thread
             static auto init(int32_t sev) {
-                _instance._severity = (severity)sev;
+                std::lock_guard<decltype(_instance._mtx)> l(_instance._mtx);
+                _instance._severity.store((severity)sev, std::memory_order_relaxed);
+                _instance.apply();
+            }
+
+            // level of one module regardless of the global one, -1: follow the global one again
+            static auto init(module mod, int32_t sev) {
+                std::lock_guard<decltype(_instance._mtx)> l(_instance._mtx);
+                _instance._own[(uint32_t)mod].store(sev, std::memory_order_relaxed);
+                _instance.apply();
+            }
+
+            static auto level() {
+                return (int32_t)_instance._severity.load(std::memory_order_relaxed);
+            }
+
+            static auto name(module mod) {
+                static char const* const names[] = { "general", "feed", "order_book", "reference", "bar" };
+                return names[(uint32_t)mod];
+            }
+
+            static auto enabled(severity sev, module mod) {
+                return sev >= _instance._levels[(uint32_t)mod].load(std::memory_order_relaxed);
+            }
+
+            // unconditionally, callers check enabled first
+            template<typename ... ARGS> static auto write(severity sev, ARGS const& ... args) {
+                _instance.print(sev, args ...);
             }
 
-            template<typename ... ARGS> static auto debug(ARGS ... args) {
-                _instance.print(severity::debug, args ...);
+            template<typename ... ARGS> static auto debug(ARGS const& ... args) {
+                TOY_LOG(debug, general, args ...);
             }
 
-            template<typename ... ARGS> static auto info(ARGS ... args) {
-                _instance.print(severity::info, args ...);
+            template<typename ... ARGS> static auto info(ARGS const& ... args) {
+                TOY_LOG(info, general, args ...);
             }
 
-            template<typename ... ARGS> static auto warn(ARGS ... args) {
-                _instance.print(severity::warn, args ...);
+            template<typename ... ARGS> static auto warn(ARGS const& ... args) {
+                TOY_LOG(warn, general, args ...);
             }
 
-            template<typename ... ARGS> static auto error(ARGS ... args) {
-                _instance.print(severity::error, args ...);
+            template<typename ... ARGS> static auto error(ARGS const& ... args) {
+                TOY_LOG(error, general, args ...);
             }
 
         private:
             static log _instance;
 
-            severity _severity = severity::debug;
+            std::atomic<severity> _severity { severity::debug };
+            std::atomic<int32_t> _own[modules] { { -1 }, { -1 }, { -1 }, { -1 }, { -1 } };
+            std::atomic<severity> _levels[modules] {};
             std::mutex _mtx;
     };
 
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "reference/signals.hpp"
+
+namespace toy {
+    namespace order_book {
+
+        using reference::signals;
+
+        // order-flow analytics of every instrument, one column per value, indexed by instrument slot.
+        // quote() and trade() keep the top of the book, order-flow imbalance and traded volume current on every
+        // book change and execution. Spread, mid, microprice and imbalance only depend on the top, they are
+        // derived on demand: for one slot at publish, or for all slots at once by sample(), a branch-free pass
+        // over contiguous columns the compiler vectorizes.
+        class analytics {
+            public:
+                // columns grow by one, returns its slot
+                auto add() {
+                    for(auto pcol : { &_bid_qty, &_bid_prc, &_ask_qty, &_ask_prc, &_turnover,
+                            &_spread, &_mid, &_microprice, &_imbalance }) {
+                        pcol->push_back(0.0);
+                    }
+                    _ofi.push_back(0);
+                    _volume.push_back(0);
+                    return (uint32_t)(_ofi.size() - 1);
+                }
+
+                auto size() const { return (uint32_t)_ofi.size(); }
+
+                // new top of the book, qty 0 for an empty side. Order-flow imbalance (Cont, Kukanov, Stoikov)
+                // counts quantity joining the best bid or leaving the best ask as buying pressure and vice versa,
+                // across price changes. A side that is or was empty contributes nothing.
+                auto quote(uint32_t slot, double bid_qty, double bid_prc, double ask_qty, double ask_prc) {
+                    auto& pbq = _bid_qty[slot];
+                    auto& pbp = _bid_prc[slot];
+                    auto& paq = _ask_qty[slot];
+                    auto& pap = _ask_prc[slot];
+
+                    auto e = 0.0;
+                    if(bid_qty > 0.0 && pbq > 0.0) {
+                        e += (bid_prc >= pbp ? bid_qty : 0.0) - (bid_prc <= pbp ? pbq : 0.0);
+                    }
+                    if(ask_qty > 0.0 && paq > 0.0) {
+                        e += (ask_prc >= pap ? paq : 0.0) - (ask_prc <= pap ? ask_qty : 0.0);
+                    }
+                    _ofi[slot] += (int64_t)e;
+
+                    pbq = bid_qty;
+                    pbp = bid_prc;
+                    paq = ask_qty;
+                    pap = ask_prc;
+                }
+
+                auto trade(uint32_t slot, int64_t qty, double prc) {
+                    _volume[slot] += qty;
+                    _turnover[slot] += qty * prc;
+                }
+
+                // derived columns of every slot
+                auto sample() {
+                    derive(0, size());
+                }
+
+                auto get(uint32_t slot, reference::instrument_id iid) {
+                    derive(slot, slot + 1);
+                    return signals { iid, _spread[slot], _mid[slot], _microprice[slot], _imbalance[slot], _ofi[slot],
+                        _volume[slot], _volume[slot] ? _turnover[slot] / _volume[slot] : 0.0 };
+                }
+
+                // columns, derived ones as of the last sample()
+                auto spread() const -> double const* { return _spread.data(); }
+                auto mid() const -> double const* { return _mid.data(); }
+                auto microprice() const -> double const* { return _microprice.data(); }
+                auto imbalance() const -> double const* { return _imbalance.data(); }
+                auto ofi() const -> int64_t const* { return _ofi.data(); }
+                auto volume() const -> int64_t const* { return _volume.data(); }
+
+            private:
+                auto derive(uint32_t first, uint32_t last) -> void {
+                    derive(_bid_qty.data(), _bid_prc.data(), _ask_qty.data(), _ask_prc.data(),
+                            _spread.data(), _mid.data(), _microprice.data(), _imbalance.data(), first, last);
+                }
+
+                // quoted is 1 with both sides on the book and 0 otherwise, multiplying by it rather than branching
+                // and __restrict on the columns keep the loop vectorizable; adding 0.0 turns the -0.0 of an empty
+                // bid back into 0.0
+                static auto derive(double const* __restrict bq, double const* __restrict bp,
+                        double const* __restrict aq, double const* __restrict ap,
+                        double* __restrict spread, double* __restrict mid,
+                        double* __restrict micro, double* __restrict imb, size_t first, size_t last) -> void {
+                    for(auto i = first; i < last; i ++) {
+                        auto quoted = (double)(bq[i] > 0.0) * (double)(aq[i] > 0.0);
+                        auto total = std::max(bq[i] + aq[i], 1.0);
+                        spread[i] = (ap[i] - bp[i]) * quoted + 0.0;
+                        mid[i] = (ap[i] + bp[i]) * 0.5 * quoted;
+                        micro[i] = (bp[i] * aq[i] + ap[i] * bq[i]) / total * quoted;
+                        imb[i] = (bq[i] - aq[i]) / total + 0.0;
+                    }
+                }
+
+            private:
+                // top of the book, quantities as double so every column pass runs on one type
+                std::vector<double> _bid_qty;
+                std::vector<double> _bid_prc;
+                std::vector<double> _ask_qty;
+                std::vector<double> _ask_prc;
+
+                std::vector<int64_t> _ofi;
+                std::vector<int64_t> _volume;
+                std::vector<double> _turnover;
+
+                std::vector<double> _spread;
+                std::vector<double> _mid;
+                std::vector<double> _microprice;
+                std::vector<double> _imbalance;
+        };
+
+    }
+}
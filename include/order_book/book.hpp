@@ -1,11 +1,16 @@
 #pragma once
 
 #include <cassert>
-#include <map>
+#include <algorithm>
+#include <chrono>
 
+#include "log.hpp"
 #include "reference/order.hpp"
 #include "reference/market.hpp"
 
+#include "ladder.hpp"
+#include "levels.hpp"
+
 namespace toy {
     namespace order_book {
 
@@ -14,22 +19,45 @@ namespace toy {
         using reference::level;
         using reference::market;
 
-        class book {
-            public:
-                book(instrument_id iid) : _iid(iid) {}
+        struct book_health {
+            int32_t bad_bids;       // levels with non-positive quantity
+            int32_t bad_asks;
+            uint32_t complaints;    // snapshots withheld by verify
+            int64_t corrupted_ns;   // time between first complaint and recovery, accumulated
+        };
 
+        // price levels of each side are kept by STORAGE, see levels.hpp
+        template<typename STORAGE> class basic_book {
+            public:
+                // tick of the depth ladders, instruments without one in their spec are assumed to trade in cents
+                basic_book(instrument_id iid, double tick = 0.0)
+                    : _iid(iid), _asks(_arena.template make<prc_less>()), _bids(_arena.template make<prc_greater>()),
+                      _bid_depth(tick > 0.0 ? tick : 0.01), _ask_depth(tick > 0.0 ? tick : 0.01) {}
+
+                // levels may live in the arena
+                basic_book(basic_book const&) = delete;
+                auto operator=(basic_book const&) = delete;
+
+                // only non-positive levels left by disordered transactions can make the book unhealthy,
+                // they are counted by add/can/amd so the common healthy case costs nothing. The counts cover
+                // the whole book, while one is non-zero the visible depth is scanned to see if it is in view.
                 auto verify(int32_t max_lev, int32_t tolerance) {
                     if(_times <= tolerance) {
                         return true;
                     }
 
+                    if(!_bad_bids && !_bad_asks) {
+                        recovered();
+                        return true;
+                    }
+
                     auto bit = _bids.begin();
                     auto ait = _asks.begin();
                     for(auto i = 0; i < max_lev; i ++) {
                         if(_bids.end() != bit) {
                             if(bit->second <= 0) {
-                                log::warn(" ------> Complain! Incomplate bid -", bit->first, bit->second);
-                                _times = 0;
+                                TOY_LOG(warn, order_book, " ------> Complain! Incomplate bid -", bit->first, bit->second);
+                                complain();
                                 return false;
                             }
                             bit ++;
@@ -37,15 +65,26 @@ namespace toy {
                         }
                         if(_asks.end() != ait) {
                             if(ait->second <= 0) {
-                                log::warn(" ------> Complain! Incomplate ask -", ait->first, ait->second);
-                                _times = 0;
+                                TOY_LOG(warn, order_book, " ------> Complain! Incomplate ask -", ait->first, ait->second);
+                                complain();
                                 return false;
                             }
+                            ait ++;
                         }
                     }
+
+                    recovered(); // bad levels are out of visible depth
                     return true;
                 }
 
+                auto health() const {
+                    auto corrupted_ns = _corrupted_ns;
+                    if(_corrupted_since) {
+                        corrupted_ns += clock() - _corrupted_since;
+                    }
+                    return book_health { _bad_bids, _bad_asks, _complaints, corrupted_ns };
+                }
+
                 auto try_extract(market* pmkt) {
                     auto max_lev = pmkt->max_lev();
 
@@ -54,7 +93,7 @@ namespace toy {
 
                     if(_bids.end() != bit && _asks.end() != ait) {
                         if(bit->first >= ait->first) {
-                            log::debug(_iid, " is crossing", bit->first, ">=", ait->first);
+                            TOY_LOG(debug, order_book, _iid, " is crossing", bit->first, ">=", ait->first);
                             return false;
                         }
                     }
@@ -89,8 +128,8 @@ namespace toy {
                     _times ++;
 
                     switch(side) {
-                    case order_side::buy: add(_bids, qty, prc); break;
-                    case order_side::sell: add(_asks, qty, prc); break;
+                    case order_side::buy: add(_bids, _bad_bids, _bid_depth, qty, prc); break;
+                    case order_side::sell: add(_asks, _bad_asks, _ask_depth, qty, prc); break;
                     default: break;
                     }
 
@@ -101,8 +140,8 @@ namespace toy {
                     _times ++;
 
                     switch(side) {
-                    case order_side::buy: can(_bids, qty, prc); break;
-                    case order_side::sell: can(_asks, qty, prc); break;
+                    case order_side::buy: can(_bids, _bad_bids, _bid_depth, qty, prc); break;
+                    case order_side::sell: can(_asks, _bad_asks, _ask_depth, qty, prc); break;
                     default: break;
                     }
                     
@@ -113,8 +152,8 @@ namespace toy {
                     _times ++;
 
                     switch(side) {
-                    case order_side::buy: amd(_bids, qty, prc); break;
-                    case order_side::sell: amd(_asks, qty, prc); break;
+                    case order_side::buy: amd(_bids, _bad_bids, _bid_depth, qty, prc); break;
+                    case order_side::sell: amd(_asks, _bad_asks, _ask_depth, qty, prc); break;
                     default: break;
                     }
 
@@ -130,52 +169,214 @@ namespace toy {
                     return _times;
                 }
 
+            public:
+                // best positive level of each side, 0 for an empty side
+                auto top() const {
+                    level lev { 0, 0.0, 0, 0.0 };
+                    for(auto const& l : _bids) {
+                        if(l.second > 0) {
+                            lev.bid_qty = l.second;
+                            lev.bid_prc = l.first;
+                            break;
+                        }
+                    }
+                    for(auto const& l : _asks) {
+                        if(l.second > 0) {
+                            lev.ask_qty = l.second;
+                            lev.ask_prc = l.first;
+                            break;
+                        }
+                    }
+                    return lev;
+                }
+
+            public: // depth queries over every positive level, published or not
+                auto depth_at(order_side side, double prc) const -> int64_t {
+                    switch(side) {
+                    case order_side::buy: return depth_at(_bids, prc);
+                    case order_side::sell: return depth_at(_asks, prc);
+                    default: return 0;
+                    }
+                }
+
+                // quantity at prc and better prices, O(log n) over the ladder
+                auto depth_through(order_side side, double prc) const -> int64_t {
+                    switch(side) {
+                    case order_side::buy:
+                        return built(_bids, _bid_depth).valid() ? _bid_depth.total() - _bid_depth.below(prc)
+                            : scan_through(side, prc);
+                    case order_side::sell:
+                        return built(_asks, _ask_depth).valid() ? _ask_depth.up_to(prc) : scan_through(side, prc);
+                    default: return 0;
+                    }
+                }
+
+                // worst price reached filling qty against side, 0.0 if the side holds less, O(log n) over the ladder
+                auto fill_price(order_side side, int64_t qty) const -> double {
+                    switch(side) {
+                    case order_side::buy:
+                        if(!built(_bids, _bid_depth).valid()) {
+                            return scan_fill_price(side, qty);
+                        }
+                        if(qty <= 0 || qty > _bid_depth.total()) {
+                            return 0.0;
+                        }
+                        return key_of(_bids, _bid_depth.lower_bound(_bid_depth.total() - qty + 1) + _bid_depth.tick() / 2);
+                    case order_side::sell:
+                        if(!built(_asks, _ask_depth).valid()) {
+                            return scan_fill_price(side, qty);
+                        }
+                        if(qty <= 0 || qty > _ask_depth.total()) {
+                            return 0.0;
+                        }
+                        return key_of(_asks, _ask_depth.lower_bound(qty) - _ask_depth.tick() / 2);
+                    default: return 0.0;
+                    }
+                }
+
+                // linear walk from the best level, fallback once a ladder saw a price off its tick or too far out
+                auto scan_through(order_side side, double prc) const -> int64_t {
+                    switch(side) {
+                    case order_side::buy: return scan_through(_bids, prc);
+                    case order_side::sell: return scan_through(_asks, prc);
+                    default: return 0;
+                    }
+                }
+
+                auto scan_fill_price(order_side side, int64_t qty) const -> double {
+                    switch(side) {
+                    case order_side::buy: return scan_fill_price(_bids, qty);
+                    case order_side::sell: return scan_fill_price(_asks, qty);
+                    default: return 0.0;
+                    }
+                }
+
             private:
+                static auto clock() -> int64_t {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+
+                auto complain() -> void {
+                    _times = 0;
+                    _complaints ++;
+                    if(!_corrupted_since) {
+                        _corrupted_since = clock();
+                    }
+                }
+
+                auto recovered() -> void {
+                    if(_corrupted_since) {
+                        _corrupted_ns += clock() - _corrupted_since;
+                        _corrupted_since = 0;
+                    }
+                }
+
                 template<typename T>
-                auto add(T& qu, int64_t qty, double prc) -> void {
+                auto add(T& qu, int32_t& bad, ladder& depth, int64_t qty, double prc) -> void {
                     auto it = qu.find(prc);
                     if(qu.end() == it) {
-                        qu.insert({ prc, qty });
+                        if(qty > 0) { // nothing left of an order cancelled before its add
+                            qu.insert({ prc, qty });
+                            depth.update(prc, 0, qty);
+                        }
                     }
                     else {
-                        it->second += qty;
+                        adjust(qu, bad, depth, it, it->second + qty, false);
                     }
                 }
 
                 template<typename T>
-                auto can(T& qu, int64_t qty, double prc) -> void {
+                auto can(T& qu, int32_t& bad, ladder& depth, int64_t qty, double prc) -> void {
                     auto it = qu.find(prc);
                     if(qu.end() == it) {
                         qu.insert({ prc, -qty });
+                        bad ++;
                     }
                     else {
-                        del(qu, it, qty);
+                        del(qu, bad, depth, it, qty);
                     }
                 }
 
                 template<typename T>
-                auto amd(T& qu, int64_t qty, double prc) -> void {
+                auto amd(T& qu, int32_t& bad, ladder& depth, int64_t qty, double prc) -> void {
                     auto it = qu.find(prc);
                     if(qu.end() == it) {
                         return;
                     }
 
-                    it->second -= qty;
-                    if(!it->second) {
-                        qu.erase(it);
-                    }
+                    adjust(qu, bad, depth, it, it->second - qty, true);
                 }
 
                 template<typename T>
-                auto del(T& qu, typename T::iterator it, int64_t qty) -> void {
+                auto del(T& qu, int32_t& bad, ladder& depth, typename T::iterator it, int64_t qty) -> void {
                     if(it->second == (int64_t)qty) {
+                        depth.update(it->first, it->second, 0);
                         qu.erase(it);
                     }
                     else {
-                        it->second -= qty;
+                        adjust(qu, bad, depth, it, it->second - qty, false);
                     }
                 }
 
+                template<typename T>
+                auto adjust(T& qu, int32_t& bad, ladder& depth, typename T::iterator it, int64_t qty, bool erase_empty) -> void {
+                    bad -= it->second <= 0;
+                    depth.update(it->first, it->second, qty);
+                    if(erase_empty && !qty) {
+                        qu.erase(it);
+                        return;
+                    }
+
+                    it->second = qty;
+                    bad += it->second <= 0;
+                }
+
+                template<typename T>
+                static auto depth_at(T const& qu, double prc) -> int64_t {
+                    auto it = qu.find(prc);
+                    return qu.end() != it && it->second > 0 ? it->second : 0;
+                }
+
+                // the ladder of a side, built from its levels by the first depth query
+                template<typename T>
+                static auto built(T const& qu, ladder& depth) -> ladder const& {
+                    if(!depth.built()) {
+                        depth.build(qu.begin(), qu.end());
+                    }
+                    return depth;
+                }
+
+                // book price of the first level from prc on, ladder prices are only within a tick of it
+                template<typename T>
+                static auto key_of(T const& qu, double prc) -> double {
+                    auto it = qu.lower_bound(prc);
+                    return qu.end() != it ? it->first : 0.0;
+                }
+
+                template<typename T>
+                static auto scan_through(T const& qu, double prc) -> int64_t {
+                    auto qty = (int64_t)0;
+                    for(auto it = qu.begin(); qu.end() != it && !qu.key_comp()(prc, it->first); it ++) {
+                        qty += std::max(it->second, (int64_t)0);
+                    }
+                    return qty;
+                }
+
+                template<typename T>
+                static auto scan_fill_price(T const& qu, int64_t qty) -> double {
+                    if(qty <= 0) {
+                        return 0.0;
+                    }
+                    for(auto it = qu.begin(); qu.end() != it; it ++) {
+                        qty -= std::max(it->second, (int64_t)0);
+                        if(qty <= 0) {
+                            return it->first;
+                        }
+                    }
+                    return 0.0;
+                }
+
                 template<typename T>
                 auto find_best(T& qu, typename T::iterator it) -> typename T::iterator {
                     while(qu.end() != it) {
@@ -190,25 +391,40 @@ namespace toy {
             private:
                 instrument_id const _iid;
 
+                typename STORAGE::arena _arena; // before the sides, they may allocate from it
+
                 struct prc_less {
                     constexpr auto operator()(double lh, double rh) const {
                         return lh < rh;
                     }
                 };
-                std::map<double, int64_t, prc_less> _asks;
+                typename STORAGE::template side<prc_less> _asks;
 
                 struct prc_greater {
                     constexpr auto operator()(double lh, double rh) const {
                         return lh > rh;
                     }
                 };
-                std::map<double, int64_t, prc_greater> _bids;
+                typename STORAGE::template side<prc_greater> _bids;
 
                 int32_t _last_qty = 0; 
                 double _last_prc = 0.0;
 
                 int32_t _times = 0;
+
+                int32_t _bad_bids = 0; // levels with non-positive quantity
+                int32_t _bad_asks = 0;
+
+                mutable ladder _bid_depth; // positive level quantities, built by the first depth query
+                mutable ladder _ask_depth;
+
+                uint32_t _complaints = 0;
+                int64_t _corrupted_since = 0;
+                int64_t _corrupted_ns = 0;
         };
 
+        using book = basic_book<map_storage>;
+        using flat_book = basic_book<flat_storage>;
+
     }
 }
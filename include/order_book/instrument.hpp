@@ -1,47 +1,150 @@
 #pragma once
 
+#include <memory>
+
 #include "reference/market.hpp"
+#include "reference/delta.hpp"
+#include "reference/pool.hpp"
 
 #include "book.hpp"
+#include "queue.hpp"
+#include "timer_wheel.hpp"
 
 namespace toy {
     namespace order_book {
 
+        using reference::instrument_spec;
+
         using market_entity = reference::market;
+        using delta_entity = reference::market_delta;
         using book_entity = book;
+        using flat_book_entity = flat_book;
+        using queue_entity = queue;
+
+        // timer is armed while a conflated publish is pending.
+        // Book, market and, in delta mode, previous market and delta share one block from a pool of blocks
+        // of that size, each part on its own cache lines: [book][market][prev][delta]. The book is a book or
+        // a flat_book as the spec says, see with_book.
+        class instrument : public timer {
+            static size_t const line = 64;
+            static size_t const book_size = std::max(sizeof(book_entity), sizeof(flat_book_entity));
 
-        class instrument {
             public:
                 using id_type = instrument_id;
                 static id_type const invalid_id = (instrument_id)-1;
                 id_type id = invalid_id;
 
+                // bytes of the block of an instrument of that depth, 0 if too deep
+                static auto block_size(uint32_t depth, bool delta) -> size_t {
+                    auto mkt = reference::make_market_layout(depth).size;
+                    if(!mkt) {
+                        return 0;
+                    }
+                    return round_up(book_size) + round_up(mkt) * (delta ? 2 : 1)
+                        + (delta ? round_up(sizeof(delta_entity)) : 0);
+                }
+
             public:
                 instrument() = default;
-                instrument(instrument_id id, int32_t max_lev)
-                    : id(id), _pbook(new book_entity(id)), _pmkt(new market_entity(id, max_lev)) {}
+
+                // pblocks hands out blocks of block_size(spec.depth, delta)
+                instrument(instrument_id id, instrument_spec const& spec, bool l3, bool delta, reference::pool* pblocks)
+                    : id(id), _spec(spec), _pqueue(l3 ? new queue_entity : nullptr), _pblocks(pblocks) {
+                    assert(pblocks->size() >= block_size(spec.depth, delta));
+
+                    auto layout = reference::make_market_layout(spec.depth);
+                    _pblock = (char*)pblocks->allocate(block_size(spec.depth, delta));
+
+                    auto p = _pblock;
+                    if(reference::book_storage::flat == spec.storage) {
+                        _pflat = new(p) flat_book_entity(id, spec.tick);
+                    }
+                    else {
+                        _pbook = new(p) book_entity(id, spec.tick);
+                    }
+                    p += round_up(book_size);
+                    _pmkt = layout.make(p, id, spec.depth);
+                    if(delta) {
+                        p += round_up(layout.size);
+                        _pprev = layout.make(p, id, spec.depth);
+                        p += round_up(layout.size);
+                        _pdelta = new(p) delta_entity(id);
+                    }
+                }
+
+                ~instrument() {
+                    if(!_pblock) {
+                        return;
+                    }
+
+                    if(_pflat) {
+                        _pflat->~flat_book_entity();
+                    }
+                    else {
+                        _pbook->~book_entity();
+                    }
+                    _pmkt->~market_entity();
+                    if(_pdelta) {
+                        _pprev->~market_entity();
+                        _pdelta->~delta_entity();
+                    }
+                    _pblocks->deallocate(_pblock);
+                }
 
                 instrument(instrument const&) = delete;
                 auto operator=(instrument const&) = delete;
 
-                instrument(instrument&& a) : instrument() {
-                    operator=(std::move(a));
-                }
+                // constructed in place by the container and linked into the timer wheel by address, never moved
+                instrument(instrument&&) = delete;
+                auto operator=(instrument&&) = delete;
+
+                auto spec() const -> instrument_spec const& { return _spec; }
 
-                auto operator=(instrument&& a) -> instrument& {
-                    std::swap(_pbook, a._pbook);
-                    std::swap(_pmkt, a._pmkt);
-                    std::swap(id, a.id);
-                    return *this;
+                // f(book*) or f(flat_book*), whichever the instrument has, returns what f returns
+                template<typename F> auto with_book(F&& f) {
+                    return _pflat ? f(_pflat) : f(_pbook);
                 }
+                auto market() { return _pmkt; }
+                auto queue() { return _pqueue.get(); } // nullptr unless L3 mode
+
+                // delta mode only
+                auto prev() { return _pprev; }
+                auto delta() { return _pdelta; }
 
-                auto book() { return _pbook.get(); }
-                auto market() { return _pmkt.get(); }
+                // previous snapshot buffer is fully overwritten by next extraction, swap rather than copy
+                auto published() {
+                    if(_pprev) {
+                        std::swap(_pmkt, _pprev);
+                    }
+                    return _publishes ++;
+                }
 
+            private:
+                static auto round_up(size_t size) -> size_t {
+                    return (size + line - 1) & ~(line - 1);
+                }
 
             private:
-                std::unique_ptr<book_entity> _pbook { nullptr };
-                std::unique_ptr<market_entity> _pmkt { nullptr };
+                instrument_spec _spec {};
+                std::unique_ptr<queue_entity> _pqueue { nullptr };
+
+                reference::pool* _pblocks = nullptr;
+                char* _pblock = nullptr;
+                book_entity* _pbook = nullptr;      // one of them
+                flat_book_entity* _pflat = nullptr;
+                market_entity* _pmkt = nullptr;
+                market_entity* _pprev = nullptr;
+                delta_entity* _pdelta = nullptr;
+
+                uint32_t _publishes = 0;
+
+            public:
+                uint64_t next_publish = 0; // conflation only, in timer wheel ticks
+
+                uint32_t slot = 0; // column of the instrument in analytics
+
+                uint64_t messages = 0; // handled by this instrument
+                uint64_t reported = 0; // messages at last stats
         };
 
     }
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace toy {
+    namespace order_book {
+
+        // positive quantity per price tick of one side, in a Fenwick tree over ticks in ascending price.
+        // Point updates, prefix sums and inverse prefix sums are O(log n), n the ticks spanned so far;
+        // the range doubles around prices that fall outside, up to max_ticks. Nothing is allocated or
+        // kept up to date before the book builds it for its first depth query. A price off the tick grid
+        // or beyond max_ticks invalidates the ladder for good, the book answers by scanning its levels then.
+        class ladder {
+            public:
+                ladder(double tick) : _tick(tick) {}
+
+                auto tick() const { return _tick; }
+                auto built() const { return _built; }
+                auto valid() const { return _valid; }
+                auto total() const { return _total; }
+
+                auto update(double prc, int64_t old_qty, int64_t new_qty) -> void {
+                    auto delta = std::max(new_qty, (int64_t)0) - std::max(old_qty, (int64_t)0);
+                    if(!_built || !_valid || !delta) {
+                        return;
+                    }
+
+                    int64_t t;
+                    if(!to_tick(prc, t)) {
+                        invalidate();
+                        return;
+                    }
+
+                    if(_vals.empty()) {
+                        _base = t - initial / 2;
+                        _vals.assign(initial, 0);
+                        _tree.assign(initial + 1, 0);
+                    }
+                    while(t < _base || t >= _base + (int64_t)_vals.size()) {
+                        if(_vals.size() * 2 > max_ticks) {
+                            invalidate();
+                            return;
+                        }
+                        grow(t);
+                    }
+
+                    auto idx = (size_t)(t - _base);
+                    _vals[idx] += delta;
+                    _total += delta;
+                    for(auto i = idx + 1; i < _tree.size(); i += i & (~i + 1)) {
+                        _tree[i] += delta;
+                    }
+                }
+
+                // from the (price, quantity) levels of the side, kept up to date by update from then on
+                template<typename IT> auto build(IT first, IT last) -> void {
+                    _built = true;
+                    for(; first != last && _valid; ++ first) {
+                        update(first->first, 0, first->second);
+                    }
+                }
+
+                // quantity at prices up to and including prc
+                auto up_to(double prc) const {
+                    return sum((int64_t)std::floor(prc / _tick + 0.000001));
+                }
+
+                // quantity at prices strictly below prc
+                auto below(double prc) const {
+                    return sum((int64_t)std::ceil(prc / _tick - 0.000001) - 1);
+                }
+
+                // lowest tick price where up_to reaches qty, 0.0 if the side does not hold that much
+                auto lower_bound(int64_t qty) const -> double {
+                    if(qty <= 0 || qty > _total) {
+                        return 0.0;
+                    }
+
+                    auto pos = (size_t)0;
+                    for(auto step = _vals.size(); step > 0; step >>= 1) { // size is a power of 2
+                        if(pos + step < _tree.size() && _tree[pos + step] < qty) {
+                            pos += step;
+                            qty -= _tree[pos];
+                        }
+                    }
+                    return (double)(_base + (int64_t)pos) * _tick;
+                }
+
+            private:
+                static size_t const initial = 1024;
+                static size_t const max_ticks = 1 << 16; // 1 MiB a side at most
+
+                // quantity at ticks up to and including t
+                auto sum(int64_t t) const -> int64_t {
+                    if(_vals.empty() || t < _base) {
+                        return 0;
+                    }
+                    if(t >= _base + (int64_t)_vals.size()) {
+                        return _total;
+                    }
+
+                    auto sum = (int64_t)0;
+                    for(auto i = (size_t)(t - _base) + 1; i > 0; i -= i & (~i + 1)) {
+                        sum += _tree[i];
+                    }
+                    return sum;
+                }
+
+                auto to_tick(double prc, int64_t& t) const -> bool {
+                    auto ticks = prc / _tick;
+                    t = (int64_t)std::llround(ticks);
+                    return std::fabs(ticks - (double)t) < 0.000001;
+                }
+
+                auto invalidate() -> void {
+                    _valid = false;
+                    std::vector<int64_t>().swap(_vals);
+                    std::vector<int64_t>().swap(_tree);
+                }
+
+                // double the range towards t and rebuild the tree, O(n)
+                auto grow(int64_t t) -> void {
+                    auto size = _vals.size();
+                    std::vector<int64_t> vals(size * 2, 0);
+                    auto base = t < _base ? _base - (int64_t)size : _base;
+                    for(auto i = 0U; i < size; i ++) {
+                        vals[(size_t)(_base - base) + i] = _vals[i];
+                    }
+
+                    _base = base;
+                    _vals.swap(vals);
+                    _tree.assign(_vals.size() + 1, 0);
+                    for(auto i = 1U; i < _tree.size(); i ++) {
+                        _tree[i] += _vals[i - 1];
+                        auto parent = i + (i & (~i + 1));
+                        if(parent < _tree.size()) {
+                            _tree[parent] += _tree[i];
+                        }
+                    }
+                }
+
+            private:
+                double const _tick;
+                bool _built = false;
+                bool _valid = true;
+
+                int64_t _base = 0; // tick of _vals[0]
+                int64_t _total = 0;
+                std::vector<int64_t> _vals;
+                std::vector<int64_t> _tree; // 1-based
+        };
+
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "reference/pool.hpp"
+
+namespace toy {
+    namespace order_book {
+
+        // price levels of one side as a sorted vector, ordered by CMP like std::map<double, int64_t, CMP>
+        // and exposing the part of its interface book uses. Levels are stored worst first, so the busy top
+        // of the book sits at the end where inserting and erasing move little; iterators run best first.
+        // Suits sparse books of few levels over a wide price range: no node per level, and a lookup is a
+        // binary search over contiguous memory. Inserting or erasing invalidates iterators.
+        template<typename CMP> class flat_levels {
+            using value_type = std::pair<double, int64_t>;
+            using levels_type = std::vector<value_type>;
+
+            public:
+                using iterator = typename levels_type::reverse_iterator;
+                using const_iterator = typename levels_type::const_reverse_iterator;
+
+                auto begin() { return _levels.rbegin(); }
+                auto end() { return _levels.rend(); }
+                auto begin() const { return _levels.crbegin(); }
+                auto end() const { return _levels.crend(); }
+
+                auto size() const { return _levels.size(); }
+                auto empty() const { return _levels.empty(); }
+                auto key_comp() const { return CMP(); }
+
+                // first level not before prc
+                auto lower_bound(double prc) { return lower_bound(begin(), end(), prc); }
+                auto lower_bound(double prc) const { return lower_bound(begin(), end(), prc); }
+
+                auto find(double prc) { return find(begin(), end(), prc); }
+                auto find(double prc) const { return find(begin(), end(), prc); }
+
+                auto insert(value_type const& level) -> void {
+                    _levels.insert(lower_bound(level.first).base(), level);
+                }
+
+                auto erase(iterator it) -> void {
+                    _levels.erase(std::next(it).base());
+                }
+
+            private:
+                template<typename IT>
+                static auto lower_bound(IT first, IT last, double prc) {
+                    return std::lower_bound(first, last, prc,
+                            [](typename IT::value_type const& level, double prc) { return CMP()(level.first, prc); });
+                }
+
+                template<typename IT>
+                static auto find(IT first, IT last, double prc) {
+                    auto it = lower_bound(first, last, prc);
+                    return last != it && !CMP()(prc, it->first) ? it : last;
+                }
+
+            private:
+                levels_type _levels;
+        };
+
+        // storage policies of book, side<CMP> holds the levels of one side, created by arena::make
+        // from state the two sides share
+
+        // red-black tree, nodes of both sides from a pool of the book a chunk at a time
+        struct map_storage {
+            static uint32_t const nodes_per_chunk = 8;
+
+            using allocator = reference::pool_allocator<std::pair<double const, int64_t>>;
+            template<typename CMP> using side = std::map<double, int64_t, CMP, allocator>;
+
+            class arena {
+                public:
+                    template<typename CMP> auto make() { return side<CMP>(CMP(), allocator(&_nodes)); }
+
+                private:
+                    reference::pool _nodes { 0, nodes_per_chunk };
+            };
+        };
+
+        // sorted vector, see flat_levels
+        struct flat_storage {
+            template<typename CMP> using side = flat_levels<CMP>;
+
+            class arena {
+                public:
+                    template<typename CMP> auto make() { return side<CMP>(); }
+            };
+        };
+
+    }
+}
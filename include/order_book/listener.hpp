@@ -0,0 +1,21 @@
+#pragma once
+
+#include "reference/market.hpp"
+#include "reference/delta.hpp"
+#include "reference/signals.hpp"
+
+namespace toy {
+    namespace order_book {
+
+        // receives everything the manager publishes, in addition to the log
+        class listener {
+            public:
+                virtual ~listener() {}
+
+                virtual auto publish(reference::market const*) -> void = 0;
+                virtual auto publish(reference::market_delta const*) -> void {}
+                virtual auto publish(reference::signals const*) -> void {}
+        };
+
+    }
+}
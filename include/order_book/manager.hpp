@@ -1,11 +1,23 @@
 #pragma once
 
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <ostream>
+
 #include "log.hpp"
+#include "profile.hpp"
+#include "histogram.hpp"
 #include "reference/order.hpp"
 #include "reference/container.hpp"
 #include "feed/observer.hpp"
 
 #include "instrument.hpp"
+#include "listener.hpp"
+#include "analytics.hpp"
 
 namespace toy {
     namespace order_book {
@@ -13,27 +25,279 @@ namespace toy {
         using reference::order;
         using reference::trade;
         using reference::market;
+        using reference::order_id;
+        using reference::order_action;
 
         class manager : public feed::observer {
+            static uint32_t const blocks_per_chunk = 16;
+
             public:
-                manager(int32_t max_lev, int32_t interval, int32_t tolerance)
-                    : _max_lev(max_lev), _interval(interval), _tolerance(tolerance) {
+                // snapshot == 0: publish full snapshots only
+                // snapshot > 0: publish level deltas, with a full snapshot every N publishes of an instrument
+                // conflate_us > 0: publish an instrument at most once every conflate_us, the latest state is
+                // published by a timer once the window is over
+                manager(int32_t max_lev, int32_t interval, int32_t tolerance, bool l3 = false, int32_t snapshot = 0,
+                        int64_t conflate_us = 0)
+                    : _max_lev(max_lev), _interval(interval), _tolerance(tolerance), _l3(l3), _snapshot(snapshot),
+                      _resolution(std::max(conflate_us / 8, (int64_t)1)),
+                      _conflate(conflate_us > 0 ? (conflate_us + _resolution - 1) / _resolution : 0),
+                      _wheel(clock() / _resolution) {
+                    assert(reference::make_market_factory(max_lev) != nullptr);
+
+                    // one pool per market depth class, fixed from here so memory() can read them from any thread.
+                    // Chunks are only allocated once an instrument needs them
+                    for(auto depth = 8U; depth <= reference::max_market_depth; depth *= 2) {
+                        _blocks.emplace_back(new reference::pool(instrument::block_size(depth, snapshot > 0),
+                                    blocks_per_chunk, 64));
+                    }
+                }
+
+                // pre-allocate a book sized for spec. Once any instrument is provisioned, only provisioned
+                // instruments at prices the spec accepts get through, anything else is counted and dropped.
+                auto provision(instrument_spec const& spec) {
+                    if(!reference::make_market_factory(spec.depth) || _instruments.find(spec.iid)) {
+                        return false;
+                    }
+
+                    auto pinst = _instruments.create(spec.iid, spec, _l3, _snapshot > 0, blocks(spec.depth));
+                    if(!pinst) {
+                        return false;
+                    }
+                    track(pinst);
+                    _provisioned = true;
+                    return true;
+                }
+
+                // publish every pending conflated snapshot, call after feeder stopped
+                auto flush() {
+                    _wheel.drain([this](timer* pt) { publish(static_cast<instrument*>(pt)); });
+                }
+
+                // allocate L3 queue nodes of order ids [1, last], call before feeder started
+                auto reserve(order_id last) {
+                    if(_l3) {
+                        _nodes.reserve(1, last);
+                    }
+                }
+
+                // instruments known so far, call before feeder started
+                auto specs() {
+                    std::vector<instrument_spec> specs;
+                    for(auto iid : _iids) {
+                        specs.push_back(_instruments.find(iid)->spec());
+                    }
+                    return specs;
+                }
+
+                // not owned, set before feeder started
+                auto set_listener(listener* plistener) {
+                    _plistener = plistener;
+                }
+
+                // keep order-flow analytics of every instrument and publish them after each market or delta,
+                // set before feeder started
+                auto set_analytics(bool enabled) {
+                    _analyze = enabled;
+                }
+
+                // level storage of instruments created on their first order, set before feeder started
+                auto set_storage(reference::book_storage storage) {
+                    _storage = storage;
+                }
+
+            public: // runtime control, any thread
+                auto set_interval(int32_t interval) {
+                    _interval.store(interval, std::memory_order_relaxed);
+                }
+
+                auto set_tolerance(int32_t tolerance) {
+                    _tolerance.store(tolerance, std::memory_order_relaxed);
+                }
+
+                auto interval() const { return _interval.load(std::memory_order_relaxed); }
+                auto tolerance() const { return _tolerance.load(std::memory_order_relaxed); }
+
+                // messages handled per type: add, can, amd, exe
+                auto messages(uint32_t type) const { return _messages[type].load(std::memory_order_relaxed); }
+
+                // orders dropped for unknown instruments or prices out of spec
+                auto rejected() const { return _rejected.load(std::memory_order_relaxed); }
+
+                auto memory() const {
+                    auto bytes = _instruments.memory() + _nodes.memory();
+                    for(auto const& pblocks : _blocks) {
+                        bytes += pblocks->memory();
+                    }
+                    return bytes;
+                }
+
+                // run task on the feeder thread before next event, book state is only safe to touch from there
+                auto post(std::function<void()> task) {
+                    std::lock_guard<std::mutex> l(_mtx);
+                    _tasks.push_back(std::move(task));
+                    _posted.store(true, std::memory_order_relaxed);
+                }
+
+            public: // feeder thread only, see post()
+                // per instrument message count and rate since last call
+                auto stats(std::ostream& s) {
+                    auto now = clock();
+                    auto elapsed = std::max(now - _last_stats, (uint64_t)1);
+                    _last_stats = now;
+
+                    if(_delay.count()) {
+                        s << "delay p50 " << _delay.percentile(0.5) << " p99 " << _delay.percentile(0.99)
+                            << " max " << _delay.max() << " ns\n";
+                    }
+
+                    for(auto iid : _iids) {
+                        auto pinst = _instruments.find(iid);
+                        assert(pinst != nullptr);
+                        s << iid << ' ' << pinst->messages << ' '
+                            << (pinst->messages - pinst->reported) * 1000000 / elapsed << "/s\n";
+                        pinst->reported = pinst->messages;
+                    }
+                }
+
+                // analytics of every instrument as of now, one line each
+                auto sample(std::ostream& s) {
+                    _analytics.sample();
+                    for(auto iid : _iids) {
+                        auto slot = _instruments.find(iid)->slot;
+                        s << iid << " spread " << _analytics.spread()[slot] << " mid " << _analytics.mid()[slot]
+                            << " microprice " << _analytics.microprice()[slot] << " imbalance "
+                            << _analytics.imbalance()[slot] << " ofi " << _analytics.ofi()[slot] << " volume "
+                            << _analytics.volume()[slot] << '\n';
+                    }
+                }
+
+                // columns of every instrument by slot, see analytics
+                auto analytics() -> order_book::analytics& { return _analytics; }
+
+                // publish full snapshot regardless of interval and tolerance
+                auto snapshot(instrument_id iid) {
+                    auto pinst = _instruments.find(iid);
+                    if(!pinst) {
+                        return false;
+                    }
+
+                    auto pmkt = pinst->market();
+                    if(!pinst->with_book([pmkt](auto pbook) { return pbook->try_extract(pmkt); })) {
+                        return false;
+                    }
+
+                    emit(pmkt);
+                    pinst->published(); // deltas continue from here
+                    return true;
+                }
+
+            public: // L3 queries, only available in L3 mode
+                auto order_count(instrument_id iid, order_side side, double prc) {
+                    auto pinst = _instruments.find(iid);
+                    if(!pinst || !pinst->queue()) {
+                        return 0;
+                    }
+                    return pinst->queue()->count(side, prc);
+                }
+
+                auto position(order_id oid) {
+                    auto pn = _nodes.find(oid);
+                    if(!pn || !pn->plev) {
+                        return queue_position { -1, -1 };
+                    }
+
+                    auto pinst = _instruments.find(pn->iid);
+                    assert(pinst != nullptr && pinst->queue() != nullptr);
+                    return pinst->queue()->position(pn);
+                }
+
+            public: // depth queries, feeder thread only, see post()
+                auto depth_at(instrument_id iid, order_side side, double prc) {
+                    auto pinst = _instruments.find(iid);
+                    return pinst ? pinst->with_book([=](auto pbook) { return pbook->depth_at(side, prc); }) : 0;
+                }
+
+                // quantity at prc and better prices of side
+                auto depth_through(instrument_id iid, order_side side, double prc) {
+                    auto pinst = _instruments.find(iid);
+                    return pinst ? pinst->with_book([=](auto pbook) { return pbook->depth_through(side, prc); }) : 0;
+                }
+
+                // worst price reached filling qty against side, 0.0 if the side holds less
+                auto fill_price(instrument_id iid, order_side side, int64_t qty) {
+                    auto pinst = _instruments.find(iid);
+                    return pinst ? pinst->with_book([=](auto pbook) { return pbook->fill_price(side, qty); }) : 0.0;
+                }
+
+            public:
+                auto health(instrument_id iid) {
+                    auto pinst = _instruments.find(iid);
+                    if(!pinst) {
+                        return book_health { 0, 0, 0, 0 };
+                    }
+                    return pinst->with_book([](auto pbook) { return pbook->health(); });
+                }
+
+                // paced replay only, see feeder_file::set_pace
+                auto report_delay() {
+                    if(!_delay.count()) {
+                        return;
+                    }
+                    TOY_LOG(info, order_book, "DELAY", "messages", _delay.count(), "p50_ns", _delay.percentile(0.5),
+                            "p99_ns", _delay.percentile(0.99), "p999_ns", _delay.percentile(0.999), "max_ns", _delay.max());
+                }
+
+                // log health of every instrument that has ever been corrupted
+                auto report_health() {
+                    for(auto iid : _iids) {
+                        auto h = health(iid);
+                        if(h.complaints) {
+                            TOY_LOG(warn, order_book, "HEALTH", iid, "complaints", h.complaints, "corrupted_us", h.corrupted_ns / 1000,
+                                    "bad_bids", h.bad_bids, "bad_asks", h.bad_asks);
+                        }
+                    }
                 }
 
             private: // feed observer
+                // conflated publishes and control tasks come due while the feed is quiet too
+                auto idle() -> void override {
+                    if(_posted.load(std::memory_order_relaxed)) {
+                        serve();
+                    }
+
+                    expire();
+                }
+
                 auto add(order const* po) -> void override {
                     assert(po->qty > 0);
                     assert(po->qty >= po->book_qty);
                     assert(po->qty >= po->can_qty);
 
-                    log::debug("New", po);
+                    TOY_LOG(debug, order_book, "New", po);
+                    poll(0);
                     
-                    auto pinst = _instruments.retrieve(po->iid, _max_lev);
-                    assert(pinst != nullptr);
-                    auto pbook = pinst->book();
-                    assert(pbook != nullptr);
+                    auto pinst = admit(po);
+                    if(!pinst) {
+                        return;
+                    }
+                    auto times = 0;
+                    {
+                        profile::scope ps(profile::stage::book, _act);
+                        times = pinst->with_book([po](auto pbook) {
+                            return pbook->add(po->side, po->qty - po->can_qty, po->prc);
+                        });
+                    }
+                    pinst->messages ++;
+                    delayed(po->sched);
+                    observe(pinst);
 
-                    auto times = pbook->add(po->side, po->qty - po->can_qty, po->prc);
+                    // an order cancelled in full before its add never rests, it takes no node nor queue place
+                    if(pinst->queue() && po->qty > po->can_qty) {
+                        auto pn = _nodes.retrieve(po->id);
+                        assert(pn != nullptr);
+                        pn->iid = po->iid;
+                        pinst->queue()->add(pn, po->side, po->qty - po->can_qty, po->prc);
+                    }
 
                     if(!po->can_qty) {
                         update(times, pinst);
@@ -41,70 +305,302 @@ namespace toy {
                 }
 
                 auto can(order const* po, int64_t can_qty) -> void override {
-                    log::debug("Can", po, can_qty);
+                    TOY_LOG(debug, order_book, "Can", po, can_qty);
+                    poll(1);
 
-                    auto pinst = _instruments.find(po->iid);
-                    assert(pinst != nullptr);
-                    auto pbook = pinst->book();
-                    auto times = pbook->can(po->side, can_qty, po->prc);
+                    auto pinst = admit(po);
+                    if(!pinst) {
+                        return;
+                    }
+                    auto times = 0;
+                    {
+                        profile::scope ps(profile::stage::book, _act);
+                        times = pinst->with_book([po, can_qty](auto pbook) { return pbook->can(po->side, can_qty, po->prc); });
+                    }
+                    pinst->messages ++;
+                    delayed(po->sched);
+                    observe(pinst);
+                    dequeue(pinst, po->id, can_qty);
                     if(po->can_qty == po->book_qty) {
                         update(times, pinst);
                     }
                 }
 
                 auto amd(order const* po, int64_t old_book) -> void override {
-                    log::debug("Amd", po, old_book, "->", po->book_qty);
+                    TOY_LOG(debug, order_book, "Amd", po, old_book, "->", po->book_qty);
+                    poll(2);
 
-                    auto pinst = _instruments.find(po->iid);
-                    assert(pinst != nullptr);
-                    auto pbook = pinst->book();
-                    auto times = pbook->amd(po->side, old_book - po->book_qty, po->prc);
+                    auto pinst = admit(po);
+                    if(!pinst) {
+                        return;
+                    }
+                    auto times = 0;
+                    {
+                        profile::scope ps(profile::stage::book, _act);
+                        times = pinst->with_book([po, old_book](auto pbook) {
+                            return pbook->amd(po->side, old_book - po->book_qty, po->prc);
+                        });
+                    }
+                    pinst->messages ++;
+                    delayed(po->sched);
+                    observe(pinst);
+                    dequeue(pinst, po->id, old_book - po->book_qty);
 
                     update(times, pinst);
                 }
 
                 auto exe(trade const* pt) -> void override {
+                    poll(3);
 
                     auto pinst = _instruments.find(pt->iid);
                     if(!pinst) {
-                        log::error("LOGIC [unknown_exe]", pt);
+                        if(_provisioned) {
+                            reject(pt);
+                            return;
+                        }
+                        TOY_LOG(error, order_book, "LOGIC [unknown_exe]", pt);
                         return;
                     }
 
-                    auto pbook = pinst->book();
-                    assert(pbook != nullptr);
- 
-                    pbook->exe(pt->qty, pt->prc);
+                    pinst->with_book([pt](auto pbook) { return pbook->exe(pt->qty, pt->prc); });
+                    pinst->messages ++;
+                    delayed(pt->sched);
+                    if(_analyze) {
+                        _analytics.trade(pinst->slot, pt->qty, pt->prc);
+                    }
 
-                    log::info("Exe", pt);
+                    TOY_LOG(info, order_book, "Exe", pt);
                 }
 
             private:
+                static auto clock() -> uint64_t {
+                    return std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+
+                auto track(instrument* pinst) -> void {
+                    pinst->slot = _analytics.add();
+                    _iids.push_back(pinst->id);
+                }
+
+                auto observe(instrument* pinst) -> void {
+                    if(!_analyze) {
+                        return;
+                    }
+                    auto top = pinst->with_book([](auto pbook) { return pbook->top(); });
+                    _analytics.quote(pinst->slot, top.bid_qty, top.bid_prc, top.ask_qty, top.ask_prc);
+                }
+
+                // after each market or delta of the instrument
+                auto emit_signals(instrument* pinst) -> void {
+                    if(!_analyze) {
+                        return;
+                    }
+                    auto sig = _analytics.get(pinst->slot, pinst->id);
+                    emit(&sig);
+                }
+
+                // from when a paced message was due to its book update
+                auto delayed(uint64_t sched) -> void {
+                    if(!sched) {
+                        return;
+                    }
+
+                    auto now = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+                    _delay.record(now > sched ? now - sched : 0);
+                }
+
+                auto poll(uint32_t type) -> void {
+                    static order_action const acts[] = {
+                        order_action::insert, order_action::remove, order_action::amend, order_action::match
+                    };
+                    _act = acts[type];
+
+                    auto& counter = _messages[type]; // single writer
+                    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+                    if(_posted.load(std::memory_order_relaxed)) {
+                        serve();
+                    }
+
+                    expire();
+                }
+
+                // pool of instrument blocks of that depth
+                auto blocks(int32_t depth) -> reference::pool* {
+                    auto size = instrument::block_size(depth, _snapshot > 0);
+                    for(auto const& pblocks : _blocks) {
+                        if(pblocks->size() == size) {
+                            return pblocks.get();
+                        }
+                    }
+                    assert(false);
+                    return nullptr;
+                }
+
+                // instrument of the order, created on first order unless instruments are provisioned.
+                // Rejections are stateless, so cancels and amends of a rejected add are rejected too.
+                auto admit(order const* po) -> instrument* {
+                    auto pinst = _instruments.find(po->iid);
+                    if(!pinst) {
+                        if(_provisioned) {
+                            return reject(po);
+                        }
+
+                        pinst = _instruments.create(po->iid,
+                                instrument_spec { po->iid, 0.0, 0.0, 0.0, _max_lev, _storage }, _l3, _snapshot > 0,
+                                blocks(_max_lev));
+                        assert(pinst != nullptr);
+                        track(pinst);
+                    }
+
+                    if(!pinst->spec().accepts(po->prc)) {
+                        return reject(po);
+                    }
+                    return pinst;
+                }
+
+                template<typename T>
+                auto reject(T const* pdata) -> instrument* {
+                    TOY_LOG(debug, order_book, "Rejected", pdata);
+                    _rejected.store(_rejected.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    return nullptr;
+                }
+
+                auto serve() -> void {
+                    std::vector<std::function<void()>> tasks;
+                    {
+                        std::lock_guard<std::mutex> l(_mtx);
+                        tasks.swap(_tasks);
+                        _posted.store(false, std::memory_order_relaxed);
+                    }
+
+                    for(auto& task : tasks) {
+                        task();
+                    }
+                }
+
+                auto expire() -> void {
+                    if(!_conflate) {
+                        return;
+                    }
+
+                    _wheel.advance(clock() / _resolution, [this](timer* pt) { publish(static_cast<instrument*>(pt)); });
+                }
+
+                template<typename T>
+                auto emit(T const* pdata) -> void {
+                    TOY_LOG(info, order_book, pdata);
+                    if(_plistener) {
+                        _plistener->publish(pdata);
+                    }
+                }
+
+                auto dequeue(instrument* pinst, order_id oid, int64_t qty) -> void {
+                    if(!pinst->queue()) {
+                        return;
+                    }
+
+                    auto pn = _nodes.find(oid);
+                    if(!pn) {
+                        return;
+                    }
+
+                    pinst->queue()->del(pn, qty);
+                    if(!pn->linked()) {
+                        _nodes.remove(oid);
+                    }
+                }
+
                 auto update(int32_t times, instrument* pinst) -> void {
-                    if(times < _interval) {
+                    if(times < _interval.load(std::memory_order_relaxed)) {
+                        return;
+                    }
+
+                    if(_conflate && _wheel.now() < pinst->next_publish) {
+                        if(!pinst->pending()) {
+                            _wheel.schedule(pinst, pinst->next_publish);
+                        }
                         return;
                     }
 
-                    auto pbook = pinst->book();
+                    publish(pinst);
+                }
+
+                auto publish(instrument* pinst) -> void {
                     auto pmkt = pinst->market();
 
-                    if(!pbook->verify(_tolerance / 2, _max_lev)) {
-                        return;
+                    {
+                        profile::scope ps(profile::stage::extract, _act);
+                        auto depth = pinst->spec().depth;
+                        auto tolerance = _tolerance.load(std::memory_order_relaxed) / 2;
+                        if(!pinst->with_book([=](auto pbook) {
+                                    return pbook->verify(depth, tolerance) && pbook->try_extract(pmkt);
+                                })) {
+                            return;
+                        }
                     }
 
-                    if(!pbook->try_extract(pmkt)) {
+                    if(_conflate) {
+                        pinst->next_publish = _wheel.now() + _conflate;
+                        _wheel.cancel(pinst);
+                    }
+
+                    if(!pinst->delta()) {
+                        emit(pmkt);
+                        emit_signals(pinst);
+                        pinst->published();
                         return;
                     }
-                    
-                    log::info(pmkt);
+
+                    auto pdelta = pinst->delta();
+                    if(!pdelta->diff(pinst->prev(), pmkt)) {
+                        return; // nothing changed since last publish
+                    }
+
+                    if(pinst->published() % _snapshot) {
+                        emit(pdelta);
+                    }
+                    else {
+                        emit(pmkt);
+                    }
+                    emit_signals(pinst);
                 }
  
             private:
                 int32_t const _max_lev;
-                int32_t const _interval;
-                int32_t const _tolerance;
+                std::atomic<int32_t> _interval;
+                std::atomic<int32_t> _tolerance;
+                bool const _l3;
+                int32_t const _snapshot;
+                int64_t const _resolution;  // us per wheel tick
+                int64_t const _conflate;    // in wheel ticks
+                timer_wheel<> _wheel;
 
+                std::vector<std::unique_ptr<reference::pool>> _blocks; // outlive the instruments holding them
                 reference::container<instrument> _instruments;
+                std::vector<instrument_id> _iids;
+                reference::container<order_node> _nodes;
+
+                bool _provisioned = false;
+                std::atomic<uint64_t> _rejected { 0 };
+
+                std::atomic<uint64_t> _messages[4] {};
+                order_action _act = order_action::MAX; // of the message being handled
+
+                histogram _delay;
+                listener* _plistener = nullptr;
+
+                reference::book_storage _storage = reference::book_storage::map;
+
+                bool _analyze = false;
+                order_book::analytics _analytics;
+                uint64_t _last_stats = clock();
+
+                std::mutex _mtx;
+                std::atomic<bool> _posted { false };
+                std::vector<std::function<void()>> _tasks;
         };
 
     }
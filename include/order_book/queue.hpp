@@ -0,0 +1,188 @@
+#pragma once
+
+#include <cassert>
+#include <map>
+
+#include "reference/instrument.hpp"
+#include "reference/order.hpp"
+
+namespace toy {
+    namespace order_book {
+
+        using reference::instrument_id;
+        using reference::order_id;
+        using reference::order_side;
+
+        class level_queue;
+
+        // intrusive fifo node, one per live order, allocated from a reference::container
+        // indexed by the same order id as feeder's order records
+        struct order_node {
+            using id_type = order_id;
+            static id_type const invalid_id = (id_type)-1;
+
+            id_type id = invalid_id;
+            instrument_id iid;
+            int64_t qty = 0;
+
+            order_side side = order_side::MAX;
+            double prc = 0.0;
+
+            level_queue* plev = nullptr;
+            order_node* prev = nullptr;
+            order_node* next = nullptr;
+
+            order_node() = default;
+            order_node(order_id id) : id(id) {}
+            ~order_node() {
+                id = invalid_id;
+                qty = 0;
+                plev = nullptr;
+                prev = next = nullptr;
+            }
+
+            auto linked() const { return nullptr != plev; }
+        };
+
+        class level_queue {
+            public:
+                auto count() const { return _count; }
+                auto head() const { return _head; }
+                auto empty() const { return nullptr == _head; }
+
+                auto push_back(order_node* pn) {
+                    assert(!pn->linked());
+
+                    pn->plev = this;
+                    pn->prev = _tail;
+                    pn->next = nullptr;
+                    if(_tail) {
+                        _tail->next = pn;
+                    }
+                    else {
+                        _head = pn;
+                    }
+                    _tail = pn;
+                    _count ++;
+                }
+
+                auto unlink(order_node* pn) {
+                    assert(pn->plev == this);
+
+                    if(pn->prev) {
+                        pn->prev->next = pn->next;
+                    }
+                    else {
+                        _head = pn->next;
+                    }
+
+                    if(pn->next) {
+                        pn->next->prev = pn->prev;
+                    }
+                    else {
+                        _tail = pn->prev;
+                    }
+
+                    pn->plev = nullptr;
+                    pn->prev = pn->next = nullptr;
+                    _count --;
+                }
+
+            private:
+                order_node* _head = nullptr;
+                order_node* _tail = nullptr;
+                int32_t _count = 0;
+        };
+
+        struct queue_position {
+            int32_t orders; // orders ahead in the same level
+            int64_t qty;    // quantity ahead in the same level
+        };
+
+        // order level (L3) view of a book, levels are kept in price-time priority
+        class queue {
+            public:
+                auto add(order_node* pn, order_side side, int64_t qty, double prc) -> void {
+                    if(pn->linked()) {
+                        pn->qty += qty;
+                        return;
+                    }
+
+                    pn->side = side;
+                    pn->prc = prc;
+                    pn->qty = qty;
+
+                    switch(side) {
+                    case order_side::buy: _bids[prc].push_back(pn); break;
+                    case order_side::sell: _asks[prc].push_back(pn); break;
+                    default: break;
+                    }
+                }
+
+                auto del(order_node* pn, int64_t qty) -> void {
+                    if(!pn->linked()) {
+                        return;
+                    }
+
+                    pn->qty -= qty;
+                    if(pn->qty > 0) {
+                        return;
+                    }
+
+                    auto plev = pn->plev;
+                    plev->unlink(pn);
+                    if(plev->empty()) {
+                        switch(pn->side) {
+                        case order_side::buy: _bids.erase(pn->prc); break;
+                        case order_side::sell: _asks.erase(pn->prc); break;
+                        default: break;
+                        }
+                    }
+                }
+
+                auto count(order_side side, double prc) const -> int32_t {
+                    switch(side) {
+                    case order_side::buy: return count(_bids, prc);
+                    case order_side::sell: return count(_asks, prc);
+                    default: return 0;
+                    }
+                }
+
+                auto position(order_node const* pn) const -> queue_position {
+                    queue_position pos { 0, 0 };
+                    if(!pn->linked()) {
+                        return { -1, -1 };
+                    }
+
+                    for(auto it = pn->plev->head(); it != pn; it = it->next) {
+                        pos.orders ++;
+                        pos.qty += it->qty;
+                    }
+                    return pos;
+                }
+
+            private:
+                template<typename T>
+                auto count(T const& qu, double prc) const -> int32_t {
+                    auto it = qu.find(prc);
+                    return qu.end() == it ? 0 : it->second.count();
+                }
+
+            private:
+                struct prc_less {
+                    constexpr auto operator()(double lh, double rh) const {
+                        return lh < rh;
+                    }
+                };
+                std::map<double, level_queue, prc_less> _asks;
+
+                struct prc_greater {
+                    constexpr auto operator()(double lh, double rh) const {
+                        return lh > rh;
+                    }
+                };
+                std::map<double, level_queue, prc_greater> _bids;
+        };
+
+    }
+}
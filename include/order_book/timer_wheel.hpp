@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <array>
+
+namespace toy {
+    namespace order_book {
+
+        // intrusive timer, owners derive from it
+        class timer {
+            template<uint32_t, uint32_t> friend class timer_wheel;
+
+            public:
+                auto pending() const { return nullptr != _next; }
+                auto expire() const { return _expire; }
+
+            private:
+                timer* _prev = nullptr;
+                timer* _next = nullptr;
+                uint64_t _expire = 0;
+        };
+
+        // hierarchical timer wheel, LEVELS wheels of 2^BITS slots each,
+        // schedule/cancel are O(1), advance is O(ticks elapsed + timers expired).
+        template<uint32_t BITS = 8, uint32_t LEVELS = 4>
+        class timer_wheel {
+            static uint32_t const slots = 1U << BITS;
+            static uint64_t const mask = slots - 1;
+            static uint64_t const range = 1ULL << (BITS * LEVELS);
+
+            public:
+                timer_wheel(uint64_t now = 0) : _now(now) {
+                    for(auto& wheel : _wheels) {
+                        for(auto& head : wheel) {
+                            head._prev = head._next = &head;
+                        }
+                    }
+                }
+
+                timer_wheel(timer_wheel const&) = delete;
+                auto operator=(timer_wheel const&) = delete;
+
+                auto size() const { return _size; }
+                auto now() const { return _now; }
+
+                auto schedule(timer* pt, uint64_t expire) {
+                    cancel(pt);
+
+                    // expired or due now fires on the next tick
+                    pt->_expire = expire > _now ? expire : _now + 1;
+                    if(pt->_expire - _now >= range) {
+                        pt->_expire = _now + range - 1;
+                    }
+
+                    place(pt);
+                    _size ++;
+                }
+
+                auto cancel(timer* pt) {
+                    if(!pt->pending()) {
+                        return;
+                    }
+
+                    unlink(pt);
+                    _size --;
+                }
+
+                // fire every timer expired at or before now
+                template<typename F> auto advance(uint64_t now, F&& on_expire) {
+                    while(_now < now) {
+                        if(!_size) {
+                            _now = now;
+                            break;
+                        }
+
+                        _now ++;
+                        if(!(_now & mask)) {
+                            cascade(1);
+                        }
+
+                        auto& head = _wheels[0][_now & mask];
+                        while(head._next != &head) {
+                            auto pt = head._next;
+                            unlink(pt);
+                            _size --;
+                            on_expire(pt);
+                        }
+                    }
+                }
+
+                // fire every pending timer regardless of expiry, e.g. at end of stream
+                template<typename F> auto drain(F&& on_expire) {
+                    for(auto& wheel : _wheels) {
+                        for(auto& head : wheel) {
+                            while(head._next != &head) {
+                                auto pt = head._next;
+                                unlink(pt);
+                                _size --;
+                                on_expire(pt);
+                            }
+                        }
+                    }
+                }
+
+            private:
+                auto place(timer* pt) -> void {
+                    auto delta = pt->_expire - _now;
+                    auto lvl = 0U;
+                    while(lvl + 1 < LEVELS && delta >= (1ULL << (BITS * (lvl + 1)))) {
+                        lvl ++;
+                    }
+
+                    auto& head = _wheels[lvl][(pt->_expire >> (BITS * lvl)) & mask];
+                    pt->_prev = head._prev;
+                    pt->_next = &head;
+                    head._prev->_next = pt;
+                    head._prev = pt;
+                }
+
+                auto unlink(timer* pt) -> void {
+                    assert(pt->pending());
+                    pt->_prev->_next = pt->_next;
+                    pt->_next->_prev = pt->_prev;
+                    pt->_prev = pt->_next = nullptr;
+                }
+
+                // move timers of the current slot at lvl down, they are all within range of lower wheels now
+                auto cascade(uint32_t lvl) -> void {
+                    if(lvl >= LEVELS) {
+                        return;
+                    }
+
+                    auto idx = (_now >> (BITS * lvl)) & mask;
+                    if(!idx) {
+                        cascade(lvl + 1);
+                    }
+
+                    auto& head = _wheels[lvl][idx];
+                    while(head._next != &head) {
+                        auto pt = head._next;
+                        unlink(pt);
+                        place(pt);
+                    }
+                }
+
+            private:
+                uint64_t _now;
+                uint32_t _size = 0;
+
+                std::array<std::array<timer, slots>, LEVELS> _wheels;
+        };
+
+    }
+}
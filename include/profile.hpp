@@ -0,0 +1,259 @@
+#pragma once
+
+#include <cstring>
+#include <array>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "log.hpp"
+#include "reference/order.hpp"
+
+namespace toy {
+
+    // hardware counters around the main stages of message handling, per message type.
+    // Counters are opened and accumulated per thread on first use, so threads of many engines profile without
+    // sharing a cache line; what a thread counted joins the process totals when it exits or at report.
+    // Stages nest and are counted inclusively:
+    // parse contains dispatch, which contains book and extract.
+    // Whatever the kernel refuses is simply not counted.
+    class profile {
+        public:
+            enum struct stage : uint32_t {
+                parse = 0, dispatch, book, extract, MAX
+            };
+
+            enum struct event : uint32_t {
+                cycles = 0, instructions, l1d_misses, llc_misses, branch_misses, MAX
+            };
+
+            using action = reference::order_action;
+
+        private:
+            static uint32_t const stages = (uint32_t)stage::MAX;
+            static uint32_t const events = (uint32_t)event::MAX;
+            static uint32_t const actions = 4; // add, can, amd, exe
+
+            using values_type = std::array<uint64_t, events>;
+
+            struct accumulator {
+                uint64_t calls = 0;
+                values_type values { 0 };
+            };
+
+            // one counter group of the calling thread
+            class counters {
+                public:
+                    counters() {
+                        perf_event_attr attrs[events];
+                        std::memset(attrs, 0, sizeof(attrs));
+                        attrs[(uint32_t)event::cycles] = make(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+                        attrs[(uint32_t)event::instructions] = make(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+                        attrs[(uint32_t)event::l1d_misses] = make(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+                                | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+                        attrs[(uint32_t)event::llc_misses] = make(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+                        attrs[(uint32_t)event::branch_misses] = make(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+
+                        for(auto i = 0U; i < events; i ++) {
+                            attrs[i].disabled = _leader < 0;
+                            auto fd = (int)syscall(__NR_perf_event_open, &attrs[i], 0, -1, _leader, 0);
+                            if(fd < 0) {
+                                continue;
+                            }
+
+                            if(_leader < 0) {
+                                _leader = fd;
+                            }
+                            _fds[_opened] = fd;
+                            _slots[_opened ++] = i;
+                        }
+
+                        if(_leader < 0) {
+                            log::info("profile - perf counters unavailable", std::strerror(errno));
+                            return;
+                        }
+
+                        ioctl(_leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                        ioctl(_leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+                        log::info("profile - perf counters opened", _opened, "of", (uint32_t)events); // by value, events has no definition
+                    }
+
+                    ~counters() {
+                        for(auto i = 0U; i < _opened; i ++) {
+                            close(_fds[i]);
+                        }
+                    }
+
+                    auto valid() const { return _leader >= 0; }
+
+                    auto read(values_type& values) const {
+                        struct { uint64_t nr; uint64_t vals[events]; } data;
+                        if(::read(_leader, &data, sizeof(data)) <= 0) {
+                            return;
+                        }
+
+                        for(auto i = 0U; i < _opened && i < data.nr; i ++) {
+                            values[_slots[i]] = data.vals[i];
+                        }
+                    }
+
+                private:
+                    static auto make(uint32_t type, uint64_t config) -> perf_event_attr {
+                        perf_event_attr attr;
+                        std::memset(&attr, 0, sizeof(attr));
+                        attr.size = sizeof(attr);
+                        attr.type = type;
+                        attr.config = config;
+                        attr.read_format = PERF_FORMAT_GROUP;
+                        attr.exclude_kernel = 1;
+                        attr.exclude_hv = 1;
+                        return attr;
+                    }
+
+                private:
+                    int _leader = -1;
+                    uint32_t _opened = 0;
+                    int _fds[events];
+                    uint32_t _slots[events]; // event of each opened counter, in group read order
+            };
+
+            using table_type = accumulator[actions][stages];
+
+            // what the calling thread counted, known to report for as long as the thread lives
+            struct thread_state {
+                thread_state() {
+                    std::lock_guard<std::mutex> lock(_instance._mutex);
+                    _instance._threads.push_back(this);
+                }
+
+                ~thread_state() {
+                    std::lock_guard<std::mutex> lock(_instance._mutex);
+                    merge(data, _instance._data);
+                    auto& threads = _instance._threads;
+                    threads.erase(std::find(threads.begin(), threads.end(), this));
+                }
+
+                counters c;
+                table_type data;
+            };
+
+            static auto local() -> thread_state& {
+                static thread_local thread_state s;
+                return s;
+            }
+
+            static auto merge(table_type const& from, table_type& to) -> void {
+                for(auto a = 0U; a < actions; a ++) {
+                    for(auto s = 0U; s < stages; s ++) {
+                        to[a][s].calls += from[a][s].calls;
+                        for(auto i = 0U; i < events; i ++) {
+                            to[a][s].values[i] += from[a][s].values[i];
+                        }
+                    }
+                }
+            }
+
+            static auto index(action act) -> uint32_t {
+                switch(act) {
+                case action::insert: return 0;
+                case action::remove: return 1;
+                case action::amend: return 2;
+                case action::match: return 3;
+                default: return actions;
+                }
+            }
+
+        public:
+            class scope {
+                public:
+                    scope(stage st, action act) {
+                        if(!_instance._enabled || index(act) >= actions) {
+                            return;
+                        }
+
+                        auto& state = local();
+                        if(!state.c.valid()) {
+                            return;
+                        }
+
+                        _pstate = &state;
+                        _pacc = &state.data[index(act)][(uint32_t)st];
+                        state.c.read(_begin);
+                    }
+
+                    ~scope() {
+                        if(!_pacc) {
+                            return;
+                        }
+
+                        values_type end { 0 };
+                        _pstate->c.read(end);
+
+                        _pacc->calls ++;
+                        for(auto i = 0U; i < events; i ++) {
+                            _pacc->values[i] += end[i] - _begin[i];
+                        }
+                    }
+
+                    scope(scope const&) = delete;
+                    auto operator=(scope const&) = delete;
+
+                private:
+                    thread_state* _pstate = nullptr;
+                    accumulator* _pacc = nullptr;
+                    values_type _begin { 0 };
+            };
+
+            static auto init(bool enabled) {
+                _instance._enabled = enabled;
+            }
+
+            // average per call over every thread, call once all profiled threads stopped
+            static auto report() {
+                if(!_instance._enabled) {
+                    return;
+                }
+
+                table_type data {};
+                {
+                    std::lock_guard<std::mutex> lock(_instance._mutex);
+                    merge(_instance._data, data);
+                    for(auto pstate : _instance._threads) {
+                        merge(pstate->data, data);
+                    }
+                }
+
+                char const* act_names[] = { "add", "can", "amd", "exe" };
+                char const* stage_names[] = { "parse", "dispatch", "book", "extract" };
+                for(auto a = 0U; a < actions; a ++) {
+                    for(auto s = 0U; s < stages; s ++) {
+                        auto const& acc = data[a][s];
+                        if(!acc.calls) {
+                            continue;
+                        }
+
+                        auto avg = [&acc](event e) { return acc.values[(uint32_t)e] / acc.calls; };
+                        log::info("PROFILE", act_names[a], stage_names[s], "calls", acc.calls,
+                                "cycles", avg(event::cycles), "instructions", avg(event::instructions),
+                                "l1d_misses", avg(event::l1d_misses), "llc_misses", avg(event::llc_misses),
+                                "branch_misses", avg(event::branch_misses));
+                    }
+                }
+            }
+
+        private:
+            static profile _instance;
+
+            bool _enabled = false;
+
+            std::mutex _mutex;
+            table_type _data;                       // of threads that exited
+            std::vector<thread_state*> _threads;    // live ones
+    };
+
+}
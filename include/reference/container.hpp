@@ -1,7 +1,10 @@
 #pragma once
 
+#include <new>
+#include <cstdint>
 #include <limits>
 #include <array>
+#include <atomic>
 
 namespace toy {
     namespace reference {
@@ -17,12 +20,22 @@ namespace toy {
             static id_type const slot_id_digits = id_limits::digits / 4;
             static id_type const item_id_digits = id_limits::digits / 4;
 
-            static id_type const buckets_capacity = id_limits::max() >> (id_limits::digits - bucket_id_digits);
-            static id_type const bucket_capacity = id_limits::max() >> (id_limits::digits - slot_id_digits);
-            static id_type const slot_capacity = id_limits::max() >> (id_limits::digits - item_id_digits);
-
-            using slot_type = std::array<item_type, slot_capacity>;
-            using bucket_type = std::array<slot_type*, bucket_capacity>;
+            static id_type const buckets_capacity = (id_limits::max() >> (id_limits::digits - bucket_id_digits)) + 1;
+            static id_type const bucket_capacity = (id_limits::max() >> (id_limits::digits - slot_id_digits)) + 1;
+            static id_type const slot_capacity = (id_limits::max() >> (id_limits::digits - item_id_digits)) + 1;
+
+            // live counts let empty slots and buckets go back to the heap, so ids that are
+            // retired in roughly the order they were created keep the footprint bounded.
+            // Reserved slots are pinned, what was allocated ahead of use stays allocated.
+            struct slot_type {
+                std::array<item_type, slot_capacity> items;
+                uint32_t live = 0;
+                bool pinned = false;
+            };
+            struct bucket_type {
+                std::array<slot_type*, bucket_capacity> slots { { nullptr } };
+                uint32_t live = 0;
+            };
             using buckets_type = std::array<bucket_type*, buckets_capacity>;
 
             union id_wrapper {
@@ -38,13 +51,15 @@ namespace toy {
             ~container() {
                 for(auto pbucket : _buckets) {
                     if(pbucket) {
-                        for(auto pslot : *pbucket) {
+                        for(auto pslot : pbucket->slots) {
                             if(pslot) {
                                 delete pslot;
                             }
                         }
+                        delete pbucket;
                     }
                 }
+                delete _pspare;
             }
 
             template<typename ... ARGS> auto create(id_type id, ARGS ... args) {
@@ -54,11 +69,12 @@ namespace toy {
                 }
 
                 id_wrapper wrapper { id };
-                auto* pitem = &pslot->at(wrapper.item_id);
+                auto* pitem = &pslot->items.at(wrapper.item_id);
                 if(pitem->id != item_type::invalid_id) {
                     return (item_type*)nullptr;
                 }
 
+                pslot->live ++;
                 return new(pitem) item_type(id, args ...);
             }
 
@@ -69,8 +85,9 @@ namespace toy {
                 }
 
                 id_wrapper wrapper { id };
-                auto* pitem = &pslot->at(wrapper.item_id);
+                auto* pitem = &pslot->items.at(wrapper.item_id);
                 if(pitem->id == item_type::invalid_id) {
+                    pslot->live ++;
                     new(pitem) item_type(id, args ...);
                 }
 
@@ -83,7 +100,43 @@ namespace toy {
                     return;
                 }
 
+                // stores in a destructor are dead to the optimizer, default construct so the id reads invalid again
                 pitem->~item_type();
+                new(pitem) item_type();
+
+                id_wrapper wrapper { id };
+                auto pbucket = _buckets[wrapper.bucket_id];
+                auto& pslot = pbucket->slots[wrapper.slot_id];
+                if(-- pslot->live || pslot->pinned) {
+                    return;
+                }
+
+                release_slot(pslot);
+                pslot = nullptr;
+                if(-- pbucket->live) {
+                    return;
+                }
+
+                delete pbucket;
+                _buckets[wrapper.bucket_id] = nullptr;
+                _buckets_allocated.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            // allocate and touch the slots of ids [first, last] ahead of use
+            auto reserve(id_type first, id_type last) {
+                for(auto id = first; id <= last; id += slot_capacity) {
+                    pin(retrieve_slot(id));
+                    if(last - id < slot_capacity) {
+                        break;
+                    }
+                }
+                pin(retrieve_slot(last));
+            }
+
+            // bytes allocated for buckets and slots, safe to read from any thread
+            auto memory() const {
+                return _buckets_allocated.load(std::memory_order_relaxed) * sizeof(bucket_type)
+                    + _slots_allocated.load(std::memory_order_relaxed) * sizeof(slot_type);
             }
 
             auto find(id_type id) {
@@ -94,12 +147,12 @@ namespace toy {
                     return (item_type*)nullptr;
                 }
 
-                auto pslot = pbucket->at(wrapper.slot_id);
+                auto pslot = pbucket->slots.at(wrapper.slot_id);
                 if(!pslot) {
                     return (item_type*)nullptr;
                 }
 
-                auto pitem = &pslot->at(wrapper.item_id);
+                auto pitem = &pslot->items.at(wrapper.item_id);
                 if(item_type::invalid_id == pitem->id) {
                     return (item_type*)nullptr;
                 }
@@ -116,19 +169,53 @@ namespace toy {
                 id_wrapper wrapper { id };
 
                 if(!_buckets[wrapper.bucket_id]) {
-                    _buckets[wrapper.bucket_id] = new bucket_type { nullptr };
+                    _buckets[wrapper.bucket_id] = new bucket_type;
+                    _buckets_allocated.fetch_add(1, std::memory_order_relaxed);
                 }
                 auto& bucket = *_buckets[wrapper.bucket_id];
 
-                if(!bucket[wrapper.slot_id]) {
-                    bucket[wrapper.slot_id] = new slot_type;
+                if(!bucket.slots[wrapper.slot_id]) {
+                    bucket.slots[wrapper.slot_id] = acquire_slot();
+                    bucket.live ++;
                 }
 
-                return bucket[wrapper.slot_id];
+                return bucket.slots[wrapper.slot_id];
+            }
+
+            static auto pin(slot_type* pslot) -> void {
+                if(pslot) {
+                    pslot->pinned = true;
+                }
+            }
+
+            // one empty slot is kept aside so ids crossing a slot boundary back and forth do not thrash the heap
+            auto acquire_slot() -> slot_type* {
+                if(_pspare) {
+                    auto pslot = _pspare;
+                    _pspare = nullptr;
+                    return pslot;
+                }
+
+                _slots_allocated.fetch_add(1, std::memory_order_relaxed);
+                return new slot_type;
+            }
+
+            auto release_slot(slot_type* pslot) -> void {
+                if(!_pspare) {
+                    _pspare = pslot;
+                    return;
+                }
+
+                delete pslot;
+                _slots_allocated.fetch_sub(1, std::memory_order_relaxed);
             }
 
             private:
             buckets_type _buckets { nullptr };
+            slot_type* _pspare = nullptr;
+
+            std::atomic<size_t> _buckets_allocated { 0 };
+            std::atomic<size_t> _slots_allocated { 0 };
         };
     }
 }
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+
+#include "order.hpp"
+#include "market.hpp"
+
+namespace toy {
+    namespace reference {
+
+        enum struct delta_action : char {
+            insert = 'I', change = 'C', remove = 'D', trade = 'T'
+        };
+
+        // apply in sequence to the previously published levels of the same side:
+        // insert shifts levels at/after lev down, remove shifts them up, change overwrites qty.
+        struct delta {
+            delta_action act;
+            order_side side;
+            uint32_t lev;
+            uint64_t qty;
+            double prc;
+        };
+
+        class market_delta {
+            public:
+                using delta_list_type = std::vector<delta>;
+
+                market_delta(instrument_id iid) : _iid(iid) {}
+
+                auto iid() const { return _iid; }
+                auto size() const { return _data.size(); }
+                auto empty() const { return _data.empty(); }
+                auto begin() const { return _data.begin(); }
+                auto end() const { return _data.end(); }
+
+                auto diff(market const* prev, market const* curr) {
+                    assert(prev->max_lev() == curr->max_lev());
+
+                    _data.clear();
+                    auto change = curr->compare(prev);
+                    diff(order_side::buy, prev, curr, change.bid);
+                    diff(order_side::sell, prev, curr, change.ask);
+
+                    if(prev->last_qty() != curr->last_qty() || prev->last_prc() != curr->last_prc()) {
+                        _data.push_back({ delta_action::trade, order_side::MAX, 0, (uint64_t)curr->last_qty(), curr->last_prc() });
+                    }
+
+                    return !_data.empty();
+                }
+
+            private:
+                // merge walk over two sorted level lists, both are terminated by an empty (qty 0) level.
+                // Levels before first are identical and skipped.
+                auto diff(order_side side, market const* prev, market const* curr, uint32_t first) -> void {
+                    auto qty = [side](market const* pm, uint32_t i) {
+                        return order_side::buy == side ? pm->bid_qty(i) : pm->ask_qty(i);
+                    };
+                    auto prc = [side](market const* pm, uint32_t i) {
+                        return order_side::buy == side ? pm->bid_prc(i) : pm->ask_prc(i);
+                    };
+                    auto better = [side](double lh, double rh) {
+                        return order_side::buy == side ? lh > rh : lh < rh;
+                    };
+
+                    auto max_lev = (uint32_t)curr->max_lev();
+                    auto lev = first, i = first, j = first;
+                    while(true) {
+                        auto old_valid = i < max_lev && qty(prev, i) > 0;
+                        auto new_valid = j < max_lev && qty(curr, j) > 0;
+                        if(!old_valid && !new_valid) {
+                            break;
+                        }
+
+                        if(old_valid && new_valid && prc(prev, i) == prc(curr, j)) {
+                            if(qty(prev, i) != qty(curr, j)) {
+                                _data.push_back({ delta_action::change, side, lev, qty(curr, j), prc(curr, j) });
+                            }
+                            lev ++; i ++; j ++;
+                        }
+                        else if(new_valid && (!old_valid || better(prc(curr, j), prc(prev, i)))) {
+                            _data.push_back({ delta_action::insert, side, lev, qty(curr, j), prc(curr, j) });
+                            lev ++; j ++;
+                        }
+                        else {
+                            _data.push_back({ delta_action::remove, side, lev, 0, prc(prev, i) });
+                            i ++;
+                        }
+                    }
+                }
+
+            private:
+                instrument_id const _iid;
+
+                delta_list_type _data;
+        };
+
+    }
+}
@@ -1,10 +1,54 @@
 #pragma once
 
 #include <cstdint>
+#include <cmath>
+#include <string>
+#include <vector>
 
 namespace toy {
     namespace reference {
         
         using instrument_id = uint32_t;
+
+        // ids first to last, both included
+        struct instrument_range {
+            instrument_id first;
+            instrument_id last;
+        };
+
+        // how an order book keeps price levels, see order_book::basic_book.
+        // map: tree of nodes, any number of levels; flat: sorted vector, for sparse books of few levels
+        enum struct book_storage : uint32_t {
+            map = 0, flat, MAX
+        };
+
+        // "map" or "flat", false for anything else
+        extern auto parse_book_storage(std::string const& name, book_storage& storage) -> bool;
+
+        // reference data of one instrument, 0 means unchecked for tick and bounds
+        struct instrument_spec {
+            instrument_id iid;
+            double tick;
+            double min_prc;
+            double max_prc;
+            int32_t depth;
+            book_storage storage = book_storage::map;
+
+            auto accepts(double prc) const {
+                if((min_prc > 0.0 && prc < min_prc) || (max_prc > 0.0 && prc > max_prc)) {
+                    return false;
+                }
+                return tick <= 0.0 || std::fabs(prc / tick - std::round(prc / tick)) < 0.000001;
+            }
+        };
+
+        // "1,5,10-20": ids and inclusive ranges separated by commas, false if malformed. Ranges are kept as such,
+        // a single id is a range of one
+        extern auto parse_instrument_ids(std::string const& list, std::vector<instrument_range>& ranges) -> bool;
+
+        // instrument master, one "iid,tick,min_prc,max_prc,depth[,storage]" per line, '#' for comments.
+        // depth 0 takes default_depth, a missing storage default_storage.
+        extern auto load_instruments(std::string const& pathname, int32_t default_depth,
+                book_storage default_storage, std::vector<instrument_spec>& specs) -> bool;
     }
 }
@@ -1,7 +1,14 @@
 #pragma once
 
 #include <cassert>
-#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "instrument.hpp"
 
@@ -15,27 +22,38 @@ namespace toy {
             double ask_prc;
         };
 
+        // first level of each side that differs between two snapshots, max_lev() if none
+        struct market_change {
+            uint32_t bid;
+            uint32_t ask;
+        };
+
+        // levels are kept as structure of arrays, see fixed_market for the storage,
+        // levels beyond max_lev read as empty
         class market {
             public:
+                virtual ~market() {}
 
-                using level_list_type = std::vector<level>;
-
-                market(instrument_id iid, uint32_t max_lev) : _iid(iid), _data(max_lev, empty_lev) {}
+                market(market const&) = delete;
+                auto operator=(market const&) = delete;
 
                 auto iid() const { return _iid; }
-                auto max_lev() const { return _data.size(); }
+                auto max_lev() const { return _max_lev; }
 
                 auto last_qty() const { return _last_qty; }
                 auto last_prc() const { return _last_prc; }
 
-                auto bid_qty(uint32_t lev) const { return find(lev).bid_qty; }
-                auto bid_prc(uint32_t lev) const { return find(lev).bid_prc; }
-                auto ask_qty(uint32_t lev) const { return find(lev).ask_qty; }
-                auto ask_prc(uint32_t lev) const { return find(lev).ask_prc; }
+                auto bid_qty(uint32_t lev) const { return lev < _max_lev ? _bid_qty[lev] : 0; }
+                auto bid_prc(uint32_t lev) const { return lev < _max_lev ? _bid_prc[lev] : 0.0; }
+                auto ask_qty(uint32_t lev) const { return lev < _max_lev ? _ask_qty[lev] : 0; }
+                auto ask_prc(uint32_t lev) const { return lev < _max_lev ? _ask_prc[lev] : 0.0; }
 
                 auto fill(uint32_t lev, level&& data) {
-                    assert(lev < _data.size());
-                    _data[lev] = data;
+                    assert(lev < _max_lev);
+                    _bid_qty[lev] = data.bid_qty;
+                    _bid_prc[lev] = data.bid_prc;
+                    _ask_qty[lev] = data.ask_qty;
+                    _ask_prc[lev] = data.ask_prc;
                 }
 
                 auto fill(int32_t qty, double prc) {
@@ -43,22 +61,112 @@ namespace toy {
                     _last_prc = prc;
                 }
 
-                auto find(uint32_t lev) const -> level const& {
-                    if(lev >= _data.size()) {
-                        return empty_lev; 
-                    }
-                    return _data[lev];
-                }
+                // prev must come from the same factory
+                virtual auto compare(market const* prev) const -> market_change = 0;
+
+            protected:
+                market(instrument_id iid, uint32_t max_lev, uint64_t* bid_qty, double* bid_prc,
+                        uint64_t* ask_qty, double* ask_prc)
+                    : _iid(iid), _max_lev(max_lev), _bid_qty(bid_qty), _bid_prc(bid_prc),
+                      _ask_qty(ask_qty), _ask_prc(ask_prc) {}
 
             private:
                 instrument_id const _iid;
-
-                static level const empty_lev;
+                uint32_t const _max_lev;
 
                 int32_t _last_qty = 0;
                 double _last_prc = 0.0;
-                level_list_type _data;
+
+                uint64_t* const _bid_qty;
+                double* const _bid_prc;
+                uint64_t* const _ask_qty;
+                double* const _ask_prc;
+        };
+
+        // depth fixed at compile time, each array on its own cache lines. Levels past max_lev stay
+        // zero in every snapshot, so comparisons run over all N and the loops are fully unrolled.
+        template<uint32_t N> class fixed_market : public market {
+            static_assert(N > 0 && 0 == N % 8, "one cache line of levels at least");
+
+            public:
+                fixed_market(instrument_id iid, uint32_t max_lev)
+                    : market(iid, max_lev, _bid_qty, _bid_prc, _ask_qty, _ask_prc) {
+                    assert(max_lev <= N);
+                }
+
+                // plain new only guarantees 16 bytes before C++17
+                static auto operator new(size_t size) -> void* {
+                    void* p = nullptr;
+                    if(posix_memalign(&p, 64, size)) {
+                        throw std::bad_alloc();
+                    }
+                    return p;
+                }
+
+                static auto operator delete(void* p) -> void {
+                    std::free(p);
+                }
+
+                // inside a larger allocation, see market_layout
+                static auto operator new(size_t, void* where) -> void* {
+                    return where;
+                }
+
+                static auto operator delete(void*, void*) -> void {}
+
+                auto compare(market const* prev) const -> market_change override {
+                    auto pm = static_cast<fixed_market const*>(prev);
+                    auto bid = first_change(_bid_qty, _bid_prc, pm->_bid_qty, pm->_bid_prc);
+                    auto ask = first_change(_ask_qty, _ask_prc, pm->_ask_qty, pm->_ask_prc);
+                    return { std::min(bid, max_lev()), std::min(ask, max_lev()) };
+                }
+
+            private:
+                // compared bitwise, prices of both snapshots come from the same book keys
+                static auto first_change(uint64_t const* lq, double const* lp, uint64_t const* rq, double const* rp) {
+#if defined(__SSE2__)
+                    for(auto i = 0U; i < N; i += 2) {
+                        auto qty = _mm_cmpeq_epi32(_mm_load_si128((__m128i const*)(lq + i)),
+                                _mm_load_si128((__m128i const*)(rq + i)));
+                        auto prc = _mm_cmpeq_epi32(_mm_load_si128((__m128i const*)(lp + i)),
+                                _mm_load_si128((__m128i const*)(rp + i)));
+                        auto mask = (uint32_t)_mm_movemask_epi8(_mm_and_si128(qty, prc));
+                        if(0xFFFF != mask) {
+                            return i + (0xFF == (mask & 0xFF) ? 1U : 0U);
+                        }
+                    }
+#else
+                    for(auto i = 0U; i < N; i ++) {
+                        if(lq[i] != rq[i] || std::memcmp(lp + i, rp + i, sizeof(double))) {
+                            return i;
+                        }
+                    }
+#endif
+                    return N;
+                }
+
+            private:
+                alignas(64) uint64_t _bid_qty[N] {};
+                alignas(64) double _bid_prc[N] {};
+                alignas(64) uint64_t _ask_qty[N] {};
+                alignas(64) double _ask_prc[N] {};
         };
 
+        using market_factory = market* (*)(instrument_id, uint32_t);
+
+        // the smallest instantiation deep enough, nullptr beyond max_market_depth
+        static uint32_t const max_market_depth = 1024;
+        extern auto make_market_factory(uint32_t max_lev) -> market_factory;
+
+        // the same instantiation constructed in place, at a 64 byte aligned address with size bytes to spare.
+        // Destroy with ~market(), the memory stays with its owner
+        struct market_layout {
+            size_t size;
+            market* (*make)(void* where, instrument_id, uint32_t max_lev);
+        };
+
+        // size 0 beyond max_market_depth
+        extern auto make_market_layout(uint32_t max_lev) -> market_layout;
+
     }
 }
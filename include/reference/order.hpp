@@ -29,6 +29,8 @@ namespace toy {
             int64_t qty = 0;
             int64_t book_qty = 0;
             int64_t can_qty = 0;
+            uint64_t sched = 0; // steady clock ns the current message was due at in paced replay, 0 otherwise
+            uint64_t ts = 0;    // us, timestamp of the message on the tape or of the last one that had it, 0 if none
 
             order() = default;
             order(order_id id) : id(id) {}
@@ -48,6 +50,8 @@ namespace toy {
             order_side side;
             double prc;
             int64_t qty;
+            uint64_t sched = 0; // see order::sched
+            uint64_t ts = 0;    // see order::ts
 
             trade() = default;
             trade(trade_id id) : id(id) {}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cassert>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <new>
+#include <vector>
+#include <atomic>
+
+namespace toy {
+    namespace reference {
+
+        // blocks of one size carved from cache-line-aligned chunks, freed blocks are reused first (lifo, so
+        // the most recently touched one comes back). Chunks only go back to the heap with the pool, the
+        // blocks of one owner stay close together instead of spreading over the heap.
+        class pool {
+            static size_t const chunk_align = 64;
+
+            public:
+                // size 0: set by the first allocation
+                explicit pool(size_t size, uint32_t per_chunk, size_t align = alignof(std::max_align_t))
+                    : _align(align), _per_chunk(per_chunk) {
+                    assert(align && !(align & (align - 1)) && align <= chunk_align);
+                    if(size) {
+                        resize(size);
+                    }
+                }
+
+                ~pool() {
+                    for(auto p : _chunks) {
+                        std::free(p);
+                    }
+                }
+
+                pool(pool const&) = delete;
+                auto operator=(pool const&) = delete;
+
+                auto allocate(size_t size) -> void* {
+                    if(!_size) {
+                        resize(size);
+                    }
+                    assert(size <= _size);
+
+                    if(!_pfree) {
+                        grow();
+                    }
+                    auto p = _pfree;
+                    _pfree = *(void**)p;
+                    return p;
+                }
+
+                auto deallocate(void* p) -> void {
+                    *(void**)p = _pfree;
+                    _pfree = p;
+                }
+
+                auto size() const { return _size; }
+                // bytes of all chunks, safe to read from any thread
+                auto memory() const { return _memory.load(std::memory_order_relaxed); }
+
+            private:
+                auto resize(size_t size) -> void {
+                    size = std::max(size, sizeof(void*));
+                    _size = (size + _align - 1) & ~(_align - 1);
+                }
+
+                // blocks are threaded in address order, handed out front to back
+                auto grow() -> void {
+                    void* p = nullptr;
+                    if(posix_memalign(&p, chunk_align, _size * _per_chunk)) {
+                        throw std::bad_alloc();
+                    }
+                    _chunks.push_back(p);
+                    _memory.fetch_add(_size * _per_chunk, std::memory_order_relaxed);
+
+                    auto base = (char*)p;
+                    for(auto i = _per_chunk; i > 0; i --) {
+                        deallocate(base + (i - 1) * _size);
+                    }
+                }
+
+            private:
+                size_t const _align;
+                uint32_t const _per_chunk;
+                size_t _size = 0;
+
+                void* _pfree = nullptr;
+                std::vector<void*> _chunks;
+                std::atomic<size_t> _memory { 0 };
+        };
+
+        // single objects from a pool, anything else from the heap; std::map and std::set only allocate nodes
+        // one at a time, so all of theirs come from the pool, which takes the node size on first use
+        template<typename T> class pool_allocator {
+            template<typename U> friend class pool_allocator;
+
+            public:
+                using value_type = T;
+
+                explicit pool_allocator(pool* ppool) : _ppool(ppool) {}
+                template<typename U> pool_allocator(pool_allocator<U> const& a) : _ppool(a._ppool) {}
+
+                auto allocate(size_t n) -> T* {
+                    if(1 == n) {
+                        return (T*)_ppool->allocate(sizeof(T));
+                    }
+                    return (T*)::operator new(n * sizeof(T));
+                }
+
+                auto deallocate(T* p, size_t n) -> void {
+                    if(1 == n) {
+                        _ppool->deallocate(p);
+                        return;
+                    }
+                    ::operator delete(p);
+                }
+
+                template<typename U> auto operator==(pool_allocator<U> const& a) const { return _ppool == a._ppool; }
+                template<typename U> auto operator!=(pool_allocator<U> const& a) const { return _ppool != a._ppool; }
+
+            private:
+                pool* _ppool;
+        };
+
+    }
+}
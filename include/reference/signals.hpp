@@ -0,0 +1,22 @@
+#pragma once
+
+#include "instrument.hpp"
+
+namespace toy {
+    namespace reference {
+
+        // order-flow analytics of one instrument, published after its market, see order_book::analytics.
+        // Prices and ratios are 0 while a side of the book is empty.
+        struct signals {
+            instrument_id iid;
+            double spread;      // best ask - best bid
+            double mid;
+            double microprice;  // best prices weighted by the quantity on the other side
+            double imbalance;   // (bid - ask) / (bid + ask) of the best quantities, in [-1, 1]
+            int64_t ofi;        // order-flow imbalance at the top of the book, accumulated since start
+            int64_t volume;     // traded
+            double vwap;
+        };
+
+    }
+}
@@ -8,9 +8,13 @@ namespace toy {
         class order;
         class trade;
         class market;
+        class market_delta;
+        struct signals;
     }
 }
 
 extern auto operator<<(std::ostream& s, toy::reference::order const*) -> std::ostream&;
 extern auto operator<<(std::ostream& s, toy::reference::trade const*) -> std::ostream&;
 extern auto operator<<(std::ostream& s, toy::reference::market const*) -> std::ostream&;
+extern auto operator<<(std::ostream& s, toy::reference::market_delta const*) -> std::ostream&;
+extern auto operator<<(std::ostream& s, toy::reference::signals const*) -> std::ostream&;
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <cstring>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "log.hpp"
+
+namespace toy {
+
+    // placement and scheduling of the calling thread, anything failing (e.g. EPERM for SCHED_FIFO)
+    // is reported and the thread keeps running with what it has got.
+    struct thread_policy {
+        int32_t cpu = -1;       // -1: any
+        int32_t fifo = 0;       // > 0: SCHED_FIFO priority
+        int32_t nice = 0;       // SCHED_OTHER only
+
+        // "default", "fifo:<prio>" or "nice:<n>"
+        auto parse_sched(std::string const& raw) {
+            if(raw.empty() || raw == "default") {
+                return true;
+            }
+
+            auto pos = raw.find(':');
+            if(std::string::npos == pos) {
+                return false;
+            }
+
+            auto kind = raw.substr(0, pos);
+            auto val = std::atoi(raw.c_str() + pos + 1);
+            if(kind == "fifo" && val > 0) {
+                fifo = val;
+                return true;
+            }
+            if(kind == "nice") {
+                nice = val;
+                return true;
+            }
+            return false;
+        }
+
+        // threads inherit the placement and scheduling of the thread that starts them, what is left at
+        // any / default is set back to it rather than kept from the parent
+        auto apply(std::string const& name) const {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if(cpu >= 0) {
+                CPU_SET(cpu, &set);
+            }
+            else {
+                for(auto i = 0; i < CPU_SETSIZE; i ++) {
+                    CPU_SET(i, &set);
+                }
+            }
+            if(auto err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set)) {
+                log::warn("thread", name, "failed to pin to cpu", cpu, std::strerror(err));
+            }
+
+            if(fifo > 0) {
+                sched_param param {};
+                param.sched_priority = fifo;
+                if(auto err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+                    log::warn("thread", name, "failed to set SCHED_FIFO", fifo, std::strerror(err));
+                }
+            }
+            else {
+                sched_param param {};
+                if(auto err = pthread_setschedparam(pthread_self(), SCHED_OTHER, &param)) {
+                    log::warn("thread", name, "failed to set SCHED_OTHER", std::strerror(err));
+                }
+                auto tid = (id_t)syscall(SYS_gettid);
+                if(getpriority(PRIO_PROCESS, tid) != nice && setpriority(PRIO_PROCESS, tid, nice) < 0) {
+                    log::warn("thread", name, "failed to set nice", nice, std::strerror(errno));
+                }
+            }
+
+            report(name);
+        }
+
+        // what the thread actually got
+        static auto report(std::string const& name) -> void {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+
+            std::string cpus;
+            for(auto i = 0; i < CPU_SETSIZE; i ++) {
+                if(CPU_ISSET(i, &set)) {
+                    cpus += (cpus.empty() ? "" : ",") + std::to_string(i);
+                }
+            }
+
+            int policy;
+            sched_param param {};
+            pthread_getschedparam(pthread_self(), &policy, &param);
+
+            log::info("thread", name, "cpus", cpus, "running on", sched_getcpu(),
+                    "sched", SCHED_FIFO == policy ? "fifo" : "other", "prio", param.sched_priority,
+                    "nice", getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid)));
+        }
+    };
+
+}
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <cstring>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "log.hpp"
+#include "engine.hpp"
+#include "../feed/parse_errors.hpp"
+#include "reference/to_string.hpp"
+
+namespace toy {
+
+    // replays independent tapes, e.g. one per day, each through an engine of its own on a bounded pool of worker
+    // threads. Engines share nothing on the message path, so tapes replay side by side at close to the rate of one
+    // per core; what each publishes goes to an output file of its own instead of the log.
+    class batch {
+        static uint32_t const categories = (uint32_t)feed::parse_error::MAX;
+
+        struct result {
+            bool replayed = false;
+            bool ok = false;
+            uint64_t lines = 0;
+            uint64_t filtered = 0;
+            uint64_t published = 0;
+            double seconds = 0.0;
+            uint64_t errors[categories] {};
+        };
+
+        public:
+            // regular files of a directory in name order, or the paths listed in a manifest file one per line,
+            // '#' for comments and relative paths against the manifest's directory
+            static auto list(std::string const& pathname, std::vector<std::string>& tapes) -> bool {
+                struct stat st;
+                if(stat(pathname.c_str(), &st) < 0) {
+                    log::error("batch - failed to open", pathname, std::strerror(errno));
+                    return false;
+                }
+
+                if(S_ISDIR(st.st_mode)) {
+                    auto pdir = opendir(pathname.c_str());
+                    if(!pdir) {
+                        log::error("batch - failed to open", pathname, std::strerror(errno));
+                        return false;
+                    }
+                    std::vector<std::string> names;
+                    while(auto pent = readdir(pdir)) {
+                        auto path = pathname + "/" + pent->d_name;
+                        if('.' != pent->d_name[0] && !stat(path.c_str(), &st) && S_ISREG(st.st_mode)) {
+                            names.push_back(path);
+                        }
+                    }
+                    closedir(pdir);
+                    std::sort(names.begin(), names.end());
+                    tapes.insert(tapes.end(), names.begin(), names.end());
+                    return true;
+                }
+
+                // every entry must exist, which also catches a tape given in place of a manifest
+                std::ifstream s(pathname);
+                auto dir = pathname.substr(0, pathname.find_last_of('/') + 1);
+                std::string line;
+                for(auto line_num = 1U; std::getline(s, line); line_num ++) {
+                    line.erase(line.find_last_not_of(" \t\r") + 1);
+                    if(line.empty() || '#' == line[0]) {
+                        continue;
+                    }
+                    auto tape = '/' == line[0] ? line : dir + line;
+                    if(stat(tape.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+                        log::error("batch - manifest", pathname, "line", line_num, "is not a tape -", line);
+                        return false;
+                    }
+                    tapes.push_back(tape);
+                }
+                return true;
+            }
+
+            // output_dir empty: published data is counted only. jobs 0: a worker per hardware thread
+            batch(engine_options const& opt, bool capture, std::string const& output_dir, uint32_t jobs)
+                : _opt(opt), _capture(capture), _output_dir(output_dir),
+                  _jobs(jobs ? jobs : std::max(std::thread::hardware_concurrency(), 1U)) {}
+
+            // every tape once, stops taking new tapes once terminate is set. False if any tape could not be
+            // replayed or its output not written; parsing errors are reported, they do not fail the batch
+            auto run(std::vector<std::string> const& tapes, std::atomic<bool> const& terminate) -> bool {
+                if(!_output_dir.empty()) {
+                    std::set<std::string> names;
+                    for(auto const& tape : tapes) {
+                        if(!names.insert(output_name(tape)).second) {
+                            log::error("batch - tapes of the same file name would share output", output_name(tape));
+                            return false;
+                        }
+                    }
+                }
+
+                auto jobs = std::min(_jobs, (uint32_t)tapes.size());
+                log::info("batch - replaying", tapes.size(), "tapes on", jobs, "workers");
+
+                std::vector<result> results(tapes.size());
+                std::atomic<size_t> next { 0 };
+                auto start = std::chrono::steady_clock::now();
+
+                std::vector<std::thread> workers;
+                for(auto i = 0U; i < jobs; i ++) {
+                    workers.emplace_back([&]() {
+                        for(auto n = next ++; n < tapes.size() && !terminate; n = next ++) {
+                            replay(tapes[n], results[n]);
+                        }
+                    });
+                }
+                for(auto& t : workers) {
+                    t.join();
+                }
+
+                auto wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                return report(results, wall);
+            }
+
+        private:
+            auto replay(std::string const& tape, result& r) -> void {
+                r.replayed = true;
+                std::unique_ptr<engine> peng(engine::make(_opt));
+                if(!peng) {
+                    return;
+                }
+
+                std::ofstream out;
+                if(!_output_dir.empty()) {
+                    auto pathname = _output_dir + "/" + output_name(tape);
+                    out.open(pathname);
+                    if(!out.good()) {
+                        log::error("batch - failed to open output", pathname);
+                        return;
+                    }
+                }
+
+                auto write = !_output_dir.empty();
+                peng->on_snapshot([&](reference::market const* pmkt) {
+                    r.published ++;
+                    if(write) {
+                        out << pmkt << '\n';
+                    }
+                });
+                peng->on_delta([&](reference::market_delta const* pdelta) {
+                    r.published ++;
+                    if(write) {
+                        out << pdelta << '\n';
+                    }
+                });
+                peng->on_signals([&](reference::signals const* psig) {
+                    r.published ++;
+                    if(write) {
+                        out << psig << '\n';
+                    }
+                });
+
+                auto start = std::chrono::steady_clock::now();
+                auto ok = _capture ? peng->replay_capture(tape) : peng->replay(tape);
+                peng->flush();
+                r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                r.lines = peng->lines();
+                r.filtered = peng->filtered();
+                for(auto i = 0U; i < categories; i ++) {
+                    r.errors[i] = peng->errors().count((feed::parse_error)i);
+                }
+
+                out.flush();
+                if(write && !out.good()) {
+                    log::error("batch - failed to write output of", tape);
+                    ok = false;
+                }
+                r.ok = ok;
+
+                auto errors = peng->errors().to_string();
+                log::info("batch -", tape, r.ok ? "done" : "FAILED", "lines", r.lines, "filtered", r.filtered,
+                        "published", r.published, "seconds", r.seconds,
+                        "lines/s", (uint64_t)(r.seconds > 0.0 ? r.lines / r.seconds : 0.0),
+                        "errors", errors.empty() ? "none" : errors);
+            }
+
+            // busy is the sum of per-tape times, busy / wall how many tapes were replaying at once on average
+            static auto report(std::vector<result> const& results, double wall) -> bool {
+                auto done = 0U, failed = 0U, skipped = 0U;
+                auto lines = (uint64_t)0, filtered = (uint64_t)0, published = (uint64_t)0;
+                auto busy = 0.0;
+                uint64_t errors[categories] {};
+                for(auto const& r : results) {
+                    (!r.replayed ? skipped : r.ok ? done : failed) ++;
+                    lines += r.lines;
+                    filtered += r.filtered;
+                    published += r.published;
+                    busy += r.seconds;
+                    for(auto i = 0U; i < categories; i ++) {
+                        errors[i] += r.errors[i];
+                    }
+                }
+
+                log::info("BATCH tapes", results.size(), "done", done, "failed", failed, "skipped", skipped,
+                        "lines", lines, "filtered", filtered, "published", published, "seconds", wall,
+                        "lines/s", (uint64_t)(wall > 0.0 ? lines / wall : 0.0),
+                        "parallelism", wall > 0.0 ? busy / wall : 0.0);
+
+                std::ostringstream s;
+                for(auto i = 0U; i < categories; i ++) {
+                    if(errors[i]) {
+                        s << (s.tellp() ? " " : "") << feed::parse_errors::name((feed::parse_error)i) << ' ' << errors[i];
+                    }
+                }
+                if(s.tellp()) {
+                    TOY_LOG(warn, feed, "PARSING_ERRORS", s.str());
+                }
+                return !failed && !skipped;
+            }
+
+            static auto output_name(std::string const& tape) -> std::string {
+                return tape.substr(tape.find_last_of('/') + 1) + ".out";
+            }
+
+        private:
+            engine_options const _opt;
+            bool const _capture;
+            std::string const _output_dir;
+            uint32_t const _jobs;
+    };
+
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <map>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "log.hpp"
+#include "thread.hpp"
+
+namespace toy {
+    namespace control {
+
+        // line based commands on a local unix domain socket, one connection at a time,
+        // serviced on its own thread so the feed is never blocked by it.
+        //   > set order_book_interval 5
+        //   < OK
+        class server {
+            public:
+                using handler_type = std::function<std::string(std::istream&)>;
+
+                server(std::string const& pathname, thread_policy const& policy = thread_policy())
+                    : _pathname(pathname), _policy(policy) {}
+                ~server() { stop(); }
+
+                auto register_command(std::string const& name, handler_type handler) {
+                    _handlers[name] = handler;
+                }
+
+                auto start() {
+                    stop();
+
+                    if(_pathname.size() >= sizeof(sockaddr_un::sun_path)) {
+                        log::error("control socket path too long", _pathname);
+                        return false;
+                    }
+
+                    _fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+                    if(_fd < 0) {
+                        log::error("failed to create control socket");
+                        return false;
+                    }
+
+                    sockaddr_un addr {};
+                    addr.sun_family = AF_UNIX;
+                    _pathname.copy(addr.sun_path, _pathname.size());
+                    ::unlink(_pathname.c_str());
+
+                    if(::bind(_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(_fd, 4) < 0) {
+                        log::error("failed to listen on control socket", _pathname);
+                        ::close(_fd);
+                        _fd = -1;
+                        return false;
+                    }
+
+                    log::info("control socket listening on", _pathname);
+
+                    _stop = false;
+                    _thrd = std::thread([&]() {
+                        _policy.apply("control");
+
+                        while(!_stop) {
+                            pollfd pfd { _fd, POLLIN, 0 };
+                            if(::poll(&pfd, 1, 200) <= 0) {
+                                continue;
+                            }
+
+                            auto conn = ::accept(_fd, nullptr, nullptr);
+                            if(conn < 0) {
+                                continue;
+                            }
+                            serve(conn);
+                            ::close(conn);
+                        }
+                    });
+
+                    return true;
+                }
+
+                auto stop() -> void {
+                    if(_thrd.joinable()) {
+                        _stop = true;
+                        _thrd.join();
+                    }
+
+                    if(_fd >= 0) {
+                        ::close(_fd);
+                        ::unlink(_pathname.c_str());
+                        _fd = -1;
+                    }
+                }
+
+            private:
+                auto serve(int conn) -> void {
+                    std::string buf;
+                    char data[256];
+                    while(!_stop) {
+                        pollfd pfd { conn, POLLIN, 0 };
+                        if(::poll(&pfd, 1, 200) <= 0) {
+                            continue;
+                        }
+
+                        auto n = ::read(conn, data, sizeof(data));
+                        if(n <= 0) {
+                            return;
+                        }
+                        buf.append(data, n);
+
+                        size_t pos;
+                        while(std::string::npos != (pos = buf.find('\n'))) {
+                            auto reply = execute(buf.substr(0, pos)) + '\n';
+                            buf.erase(0, pos + 1);
+                            if(::write(conn, reply.data(), reply.size()) < 0) {
+                                return;
+                            }
+                        }
+                    }
+                }
+
+                auto execute(std::string const& line) -> std::string {
+                    std::istringstream ss(line);
+                    std::string name; ss >> name;
+                    if(name.empty()) {
+                        return "";
+                    }
+
+                    auto it = _handlers.find(name);
+                    if(_handlers.end() == it) {
+                        std::string help = "ERR unknown command, available:";
+                        for(auto const& h : _handlers) {
+                            help += ' ' + h.first;
+                        }
+                        return help;
+                    }
+
+                    log::info("control -", line);
+                    return it->second(ss);
+                }
+
+            private:
+                std::string _pathname;
+                thread_policy _policy;
+                std::map<std::string, handler_type> _handlers;
+
+                int _fd = -1;
+                std::atomic<bool> _stop { false };
+                std::thread _thrd;
+        };
+
+    }
+}
@@ -0,0 +1,159 @@
+
+#include <fstream>
+
+#include "log.hpp"
+#include "engine.hpp"
+#include "../feed/feeder_file.hpp"
+
+namespace toy {
+
+    auto engine::make(engine_options const& opt) -> engine* {
+        if(!reference::make_market_factory(opt.max_lev) || opt.max_lev <= 0) {
+            log::error("engine - max_lev must be in range [1 -", reference::max_market_depth, "]");
+            return nullptr;
+        }
+        if(opt.interval <= 0) {
+            log::error("engine - interval must be greater than 0");
+            return nullptr;
+        }
+        if(opt.tolerance < 0 || opt.snapshot < 0 || opt.conflate_us < 0) {
+            log::error("engine - tolerance, snapshot and conflate_us must be greater equal to 0");
+            return nullptr;
+        }
+
+        std::unique_ptr<engine> peng(new engine(opt));
+        for(auto const& spec : opt.instruments) {
+            if(!peng->_pbook->provision(spec)) {
+                log::error("engine - failed to provision instrument", spec.iid, "- duplicated or depth over",
+                        reference::max_market_depth);
+                return nullptr;
+            }
+        }
+        return peng.release();
+    }
+
+    engine::engine(engine_options const& opt)
+        : _pfeeder(new feed::feeder_file("", opt.tolerant, false)),
+          _pbook(new order_book::manager(opt.max_lev, opt.interval, opt.tolerance, opt.l3, opt.snapshot,
+                      opt.conflate_us)) {
+        _pfeeder->subscribe(opt.subscription);
+        _pfeeder->register_observer(_pbook.get());
+        _pbook->set_listener(this);
+        _pbook->set_analytics(opt.analytics);
+        _pbook->set_storage(opt.storage);
+    }
+
+    engine::~engine() {}
+
+    auto engine::on_snapshot(snapshot_handler handler) -> void {
+        _on_snapshot = std::move(handler);
+    }
+
+    auto engine::on_delta(delta_handler handler) -> void {
+        _on_delta = std::move(handler);
+    }
+
+    auto engine::on_signals(signals_handler handler) -> void {
+        _on_signals = std::move(handler);
+    }
+
+    auto engine::push(std::string const& line) -> bool {
+        _line_num ++;
+        if(line.empty()) {
+            return true;
+        }
+
+        _pfeeder->replay(line, _line_num);
+        return !_pfeeder->last_error();
+    }
+
+    auto engine::add(int64_t iid, int64_t oid, reference::order_side side, int64_t qty, double prc) -> bool {
+        _pfeeder->add(iid, oid, side, qty, prc, ++ _line_num);
+        return !_pfeeder->last_error();
+    }
+
+    auto engine::can(int64_t oid, reference::order_side side, int64_t qty, double prc) -> bool {
+        _pfeeder->can(oid, side, qty, prc, ++ _line_num);
+        return !_pfeeder->last_error();
+    }
+
+    auto engine::amd(int64_t oid, reference::order_side side, int64_t qty, double prc) -> bool {
+        _pfeeder->amd(oid, side, qty, prc, ++ _line_num);
+        return !_pfeeder->last_error();
+    }
+
+    auto engine::exe(int64_t iid, int64_t qty, double prc) -> bool {
+        _pfeeder->exe(iid, qty, prc, ++ _line_num);
+        return !_pfeeder->last_error();
+    }
+
+    auto engine::decode(char const* data, size_t len) -> size_t {
+        return _pfeeder->decode(data, len, _line_num);
+    }
+
+    auto engine::replay(std::string const& pathname) -> bool {
+        std::ifstream s(pathname);
+        if(!s.good()) {
+            log::error("engine - failed to open", pathname);
+            return false;
+        }
+
+        std::string line;
+        while(std::getline(s, line)) {
+            push(line);
+        }
+        return true;
+    }
+
+    auto engine::replay_capture(std::string const& pathname) -> bool {
+        std::ifstream s(pathname, std::ios_base::binary);
+        if(!s.good()) {
+            log::error("engine - failed to open", pathname);
+            return false;
+        }
+
+        auto kept = feed::itch::read(s, [this](char const* data, size_t len) { return decode(data, len); },
+                []() { return false; });
+
+        if(kept) {
+            log::error("engine - capture", pathname, "ends inside a message");
+            return false;
+        }
+        return true;
+    }
+
+    auto engine::flush() -> void {
+        _pbook->flush();
+    }
+
+    auto engine::last_error() const -> char const* {
+        return _pfeeder->last_error();
+    }
+
+    auto engine::errors() const -> feed::parse_errors const& {
+        return _pfeeder->errors();
+    }
+
+    auto engine::filtered() const -> uint64_t {
+        return _pfeeder->filtered();
+    }
+
+    auto engine::publish(reference::market const* pmkt) -> void {
+        if(_on_snapshot) {
+            _on_snapshot(pmkt);
+        }
+    }
+
+    auto engine::publish(reference::market_delta const* pdelta) -> void {
+        if(_on_delta) {
+            _on_delta(pdelta);
+        }
+    }
+
+    auto engine::publish(reference::signals const* psig) -> void {
+        if(_on_signals) {
+            _on_signals(psig);
+        }
+    }
+
+}
@@ -1,35 +1,52 @@
 #pragma once
 
 #include <cassert>
+#include <atomic>
 #include <cmath>
 #include <thread>
 #include <chrono>
 #include <fstream>
+#include <functional>
 #include <locale>
+#include <vector>
+#include <cstring>
 
+#include "profile.hpp"
 #include "reference/container.hpp"
 #include "feed/feeder.hpp"
 
-extern auto SIGTERM_handler(int) -> void;
+#include "parse_errors.hpp"
+#include "subscription.hpp"
+#include "order_ids.hpp"
+#include "itch.hpp"
 
 namespace toy {
     namespace feed {
 
-#define LOG_WARN(FIELD, LINE) log::warn("PARSING_WARN - ", LINE, "\t- ["#FIELD"]")
-#define LOG_ERR(FIELD, LINE) log::error("PARSING_ERR  - ", LINE, "\t- ["#FIELD"]")
+#define LOG_WARN(FIELD, LINE) do { \
+        if(_errors.record(parse_error::FIELD)) { \
+            TOY_LOG(warn, feed, "PARSING_WARN - ", LINE, "\t- ["#FIELD"]"); \
+        } \
+    } while(0)
+#define LOG_ERR(FIELD, LINE) do { \
+        _last_error = #FIELD; \
+        if(_errors.record(parse_error::FIELD)) { \
+            TOY_LOG(error, feed, "PARSING_ERR  - ", LINE, "\t- ["#FIELD"]"); \
+        } \
+    } while(0)
 
         using reference::order_action;
         using reference::order_side;
         using reference::order;
         using reference::trade;
 
-        auto trim(const char*& str) {
+        inline auto trim(const char*& str) {
             while(std::isspace(*str)) {
                 str ++;
             }
         }
 
-        auto extract_act(const char*& str) {
+        inline auto extract_act(const char*& str) {
             trim(str);
             auto act = (order_action)*str;
             str ++;
@@ -43,7 +60,7 @@ namespace toy {
             return act;
         }
 
-        auto extract_uint(const char*& str, char delim = ',') {
+        inline auto extract_uint(const char*& str, char delim = ',') {
             trim(str);
             auto val = 0U;
             while(std::isdigit(*str)) {
@@ -60,7 +77,31 @@ namespace toy {
             return (int64_t)val;
         }
 
-        auto extract_side(const char*& str) {
+        // optional leading timestamp, 0 when the line has none
+        inline auto extract_ts(const char*& str, bool& valid) {
+            trim(str);
+            valid = true;
+            if(!std::isdigit(*str)) {
+                return (uint64_t)0;
+            }
+
+            auto val = (uint64_t)0;
+            while(std::isdigit(*str)) {
+                val = val * 10 + (*str - '0');
+                str ++;
+            }
+            trim(str);
+
+            if(',' != *str) {
+                valid = false;
+                return (uint64_t)0;
+            }
+
+            str ++;
+            return val;
+        }
+
+        inline auto extract_side(const char*& str) {
             trim(str);
             auto side = order_side::MAX;
             auto ch = *(str++);
@@ -80,7 +121,7 @@ namespace toy {
             return side;
         }
 
-        auto extract_prc(const char*& str) {
+        inline auto extract_prc(const char*& str) {
             trim(str);
             auto val = 0.0;
             while(std::isdigit(*str)) {
@@ -108,65 +149,142 @@ namespace toy {
             return val;
         }
 
+        enum struct tape_format {
+            csv, itch // see itch.hpp
+        };
+
         class feeder_file : public feeder {
             using order_container = reference::container<order>;
-            using trade_container = reference::container<trade>;
+            using itch_decoder = itch::decoder<feeder_file>;
+
+            friend itch_decoder;
 
             public:
                 feeder_file(std::string const& pathname, bool tolarant, bool log_comment)
                     : _pathname(pathname), _tolerant(tolarant), _log_comment(log_comment) {}
 
+            public:
+                // parse and publish one line of the tape on the calling thread
+                auto replay(std::string const& line, uint32_t line_num) -> void {
+                    _last_error = nullptr;
+
+                    if('#' == line[0]) {
+                        handle_comment(line.c_str(), line_num);
+                        return;
+                    }
+
+                    auto str = line.c_str();
+                    auto valid = true;
+                    auto ts = extract_ts(str, valid);
+                    if(!valid) {
+                        LOG_ERR(illegal_ts, line_num);
+                        return;
+                    }
+                    if(!pace(ts)) {
+                        return;
+                    }
+
+                    auto act = extract_act(str);
+                    profile::scope ps(profile::stage::parse, act);
+                    switch(act) {
+                        case order_action::insert: handle_add(str, line_num); break; 
+                        case order_action::remove: handle_can(str, line_num); break; 
+                        case order_action::amend: handle_amd(str, line_num); break; 
+                        case order_action::match: handle_exe(str, line_num); break;
+                        default: LOG_ERR(illegal_act, line_num); break; 
+                    }
+                }
+
+                // publish the complete messages of an ITCH-like capture on the calling thread, seq counts them;
+                // returns the bytes consumed, the rest is the start of a message to pass again with what follows
+                auto decode(char const* data, size_t len, uint32_t& seq) -> size_t {
+                    return itch_decoder::decode(data, len, *this, seq);
+                }
+
+                // of the file, call before the feed starts
+                auto set_format(tape_format format) {
+                    _format = format;
+                }
+
+                // replay at speed times the recorded pace of the timestamp column, speed <= 0: as fast as possible.
+                // Gaps longer than max_gap_us are shortened to it, which keeps bursts and drops idle time.
+                // Call before the feed starts.
+                auto set_pace(double speed, int64_t max_gap_us) {
+                    _speed = speed;
+                    _max_gap_ns = max_gap_us * 1000;
+                }
+
+                // pass on only lines of these instruments and of orders added on them, the others are dropped
+                // as soon as that is known and counted apart from errors. Call before the feed starts
+                auto subscribe(std::vector<reference::instrument_range> const& ranges) {
+                    for(auto const& r : ranges) {
+                        _subscription.subscribe(r);
+                    }
+                }
+
+                // lines dropped by the subscription, readable from any thread
+                auto filtered() const { return _filtered.load(std::memory_order_relaxed); }
+
+                // allocate order storage of ids [1, last] before the feed starts
+                auto reserve(reference::order_id last) {
+                    _orders.reserve(1, last);
+                    _retired.reserve(1, last);
+                }
+
+                // why the last replayed line was rejected, nullptr if it was not
+                auto last_error() const { return _last_error; }
+
+                // called on the feeder thread once the tape is done or failed to open, set before the feed starts
+                auto set_on_end(std::function<void()> on_end) {
+                    _on_end = std::move(on_end);
+                }
+
+                // rejected and tolerated lines per category, counters are readable from any thread
+                auto errors() -> parse_errors& { return _errors; }
+                auto errors() const -> parse_errors const& { return _errors; }
+
             private: // feed
                 auto start() -> bool override {
                     stop(); // anyway ...
 
                     _stop = false;
                     _thrd = std::thread([&]() {
-                        std::ifstream s(_pathname);
+                        _policy.apply("feeder");
+
+                        std::ifstream s(_pathname, std::ios::binary);
                         if(!s.good()) {
-                            log::error("failed to open market data for replay", _pathname);
-                            SIGTERM_handler(SIGTERM);
+                            TOY_LOG(error, feed, "failed to open market data for replay", _pathname);
+                            if(_on_end) {
+                                _on_end();
+                            }
                             return;
                         }
 
-                        log::info("feeder_file starting ... ", _tolerant ? "tolerant" : "strict");
-
-                        auto line_num = 0;
-
-                        while(!_stop) {
-                            line_num ++;
+                        TOY_LOG(info, feed, "feeder_file starting ... ", _tolerant ? "tolerant" : "strict");
 
-                            std::string line; std::getline(s, line);
-                            if(line.empty()) {
-                                _stop = s.eof();
-                                continue;
-                            }
-
-                            if('#' == line[0]) {
-                                handle_comment(line.c_str(), line_num);
-                                continue;
-                            }
-                      
-                            auto str = line.c_str();
-                            switch(extract_act(str)) {
-                                case order_action::insert: handle_add(str, line_num); break; 
-                                case order_action::remove: handle_can(str, line_num); break; 
-                                case order_action::amend: handle_amd(str, line_num); break; 
-                                case order_action::match: handle_exe(str, line_num); break;
-                                default: LOG_ERR(illegal_act, line_num); continue; 
-                            }
+                        if(tape_format::itch == _format) {
+                            replay_capture(s);
+                        }
+                        else {
+                            replay_lines(s);
                         }
 
                         s.close();
 
-                        log::warn("feeder_file stopped");
+                        TOY_LOG(warn, feed, "feeder_file stopped");
 
-                        SIGTERM_handler(SIGTERM);
+                        if(_on_end) {
+                            _on_end();
+                        }
                     });
 
                     return true;
                 }
 
+                auto memory() const -> size_t override {
+                    return _orders.memory() + _retired.memory() + _subscription.memory();
+                }
+
                 auto stop() -> void {
                     if(!_thrd.joinable()) {
                         return;
@@ -177,38 +295,166 @@ namespace toy {
                 }
 
             private:
+                auto replay_lines(std::istream& s) -> void {
+                    auto line_num = 0;
+
+                    while(!_stop) {
+                        line_num ++;
+
+                        std::string line; std::getline(s, line);
+                        if(line.empty()) {
+                            _stop = s.eof();
+                            continue;
+                        }
+
+                        replay(line, line_num);
+                    }
+                }
+
+                auto replay_capture(std::istream& s) -> void {
+                    auto seq = 0U;
+                    auto kept = itch::read(s,
+                            [this, &seq](char const* data, size_t len) { return decode(data, len, seq); },
+                            [this]() { return _stop.load(); });
+
+                    if(kept && !_stop) { // capture cut in the middle of a message
+                        LOG_ERR(illegal_msg, seq + 1);
+                    }
+                }
+
+                auto handle(itch::add_order const& m, uint32_t seq) -> void {
+                    if(!pace(m.timestamp() / 1000)) {
+                        return;
+                    }
+                    profile::scope ps(profile::stage::parse, order_action::insert);
+                    if(!subscribed(m.locate())) {
+                        reject((int64_t)m.ref());
+                        return;
+                    }
+                    add(m.locate(), (int64_t)m.ref(), m.side(), m.shares(), m.price(), seq);
+                }
+
+                auto handle(itch::delete_order const& m, uint32_t seq) -> void {
+                    if(!pace(m.timestamp() / 1000)) {
+                        return;
+                    }
+                    profile::scope ps(profile::stage::parse, order_action::remove);
+                    if(!admitted((int64_t)m.ref())) {
+                        return;
+                    }
+                    can((int64_t)m.ref(), m.side(), m.shares(), m.price(), seq);
+                }
+
+                auto handle(itch::replace_order const& m, uint32_t seq) -> void {
+                    if(!pace(m.timestamp() / 1000)) {
+                        return;
+                    }
+                    profile::scope ps(profile::stage::parse, order_action::amend);
+                    if(!admitted((int64_t)m.ref())) {
+                        return;
+                    }
+                    amd((int64_t)m.ref(), m.side(), m.shares(), m.price(), seq);
+                }
+
+                auto handle(itch::execute const& m, uint32_t seq) -> void {
+                    if(!pace(m.timestamp() / 1000)) {
+                        return;
+                    }
+                    profile::scope ps(profile::stage::parse, order_action::match);
+                    if(!subscribed(m.locate())) {
+                        return;
+                    }
+                    exe(m.locate(), m.shares(), m.price(), seq);
+                }
+
+                auto unknown(uint8_t, uint32_t seq) -> void {
+                    LOG_ERR(illegal_act, seq);
+                }
+
+                auto malformed(uint32_t seq) -> void {
+                    LOG_ERR(illegal_msg, seq);
+                }
+
                 auto handle_add(const char* str, uint32_t line_num) -> void {
                     auto iid = extract_uint(str);
+                    auto id = extract_uint(str);
+                    if(!subscribed(iid)) {
+                        reject(id);
+                        return;
+                    }
+                    auto side = extract_side(str);
+                    auto qty = extract_uint(str);
+                    auto prc = extract_prc(str);
+                    add(iid, id, side, qty, prc, line_num);
+                }
+
+                auto handle_can(const char* str, uint32_t line_num) -> void {
+                    auto id = extract_uint(str);
+                    if(!admitted(id)) {
+                        return;
+                    }
+                    auto side = extract_side(str);
+                    auto qty = extract_uint(str);
+                    auto prc = extract_prc(str);
+                    can(id, side, qty, prc, line_num);
+                }
+
+                auto handle_amd(const char* str, uint32_t line_num) -> void {
+                    auto id = extract_uint(str);
+                    if(!admitted(id)) {
+                        return;
+                    }
+                    auto side = extract_side(str);
+                    auto qty = extract_uint(str);
+                    auto prc = extract_prc(str);
+                    amd(id, side, qty, prc, line_num);
+                }
+
+                auto handle_exe(const char* str, uint32_t line_num) -> void {
+                    auto iid = extract_uint(str);
+                    if(!subscribed(iid)) {
+                        return;
+                    }
+                    auto qty = extract_uint(str);
+                    auto prc = extract_prc(str);
+                    exe(iid, qty, prc, line_num);
+                }
+
+            public: // decoded events, checked and tracked exactly like tape lines; line_num only labels errors
+                auto add(int64_t iid, int64_t id, order_side side, int64_t qty, double prc, uint32_t line_num = 0) -> void {
+                    _last_error = nullptr;
+
                     if(iid <= 0) {
                         LOG_ERR(illegal_iid, line_num);
                         return;
                     }
 
-                    auto id = extract_uint(str);
                     if(id <= 0) {
                         LOG_ERR(illegal_id, line_num);
                         return;
                     }
 
-                    auto side = extract_side(str);
                     if(order_side::MAX == side) {
                         LOG_ERR(illegal_side, line_num);
                         return;
                     }
 
-                    auto qty = extract_uint(str);
                     if(qty <= 0) {
                         LOG_ERR(illegal_qty, line_num);
                         return;
                     }
 
-                    auto prc = extract_prc(str);
                     if(prc <= 0.0) {
                         LOG_ERR(illegal_prc, line_num);
                         _orders.remove(id);
                         return;
                     }
 
+                    if(_retired.contains(id)) {
+                        LOG_ERR(duplicated, line_num);
+                        return;
+                    }
+
                     auto po = _orders.retrieve(id);
                     assert(po != nullptr);
                     if(po->qty > 0) {
@@ -242,35 +488,44 @@ namespace toy {
                     }
 
                     if(verify_booked_order(po, side, prc, line_num)) {
-                        publish(&observer::add, const_cast<order const*>(po));
+                        _subscription.admit(id);
+                        po->sched = _sched;
+                        po->ts = _ts;
+                        dispatch(order_action::insert, &observer::add, const_cast<order const*>(po));
+                        if(po->can_qty >= po->qty) { // cancelled before it was added
+                            retire(id);
+                        }
                     }
                 }
 
-                auto handle_can(const char* str, uint32_t line_num) -> void {
-                    auto id = extract_uint(str);
+                auto can(int64_t id, order_side side, int64_t qty, double prc, uint32_t line_num = 0) -> void {
+                    _last_error = nullptr;
+
                     if(id <= 0) {
                         LOG_ERR(illegal_id, line_num);
                         return;
                     }
 
-                    auto side = extract_side(str);
                     if(order_side::MAX == side) {
                         LOG_ERR(illegal_side, line_num);
                         return;
                     }
 
-                    auto qty = extract_uint(str);
                     if(qty <= 0) {
                         LOG_ERR(illegal_qty, line_num);
                         return;
                     }
 
-                    auto prc = extract_prc(str);
                     if(prc <= 0.0) {
                         LOG_ERR(illegal_prc, line_num);
                         return;
                     }
 
+                    if(_retired.contains(id)) {
+                        LOG_ERR(duplicated_can, line_num);
+                        return;
+                    }
+
                     auto po = _orders.retrieve(id);
                     if(po->can_qty > 0) {
                         LOG_ERR(duplicated_can, line_num);
@@ -295,36 +550,45 @@ namespace toy {
                     else {
                         if(verify_booked_order(po, side, prc, line_num)) {
                             po->can_qty = qty;
-                            publish(&observer::can, const_cast<order const*>(po), qty);
+                            po->sched = _sched;
+                            po->ts = _ts;
+                            dispatch(order_action::remove, &observer::can, const_cast<order const*>(po), qty);
+                            if(po->can_qty >= po->book_qty) {
+                                retire(id);
+                            }
                         }
                     }
                 }
 
-                auto handle_amd(const char* str, uint32_t line_num) -> void {
-                    auto id = extract_uint(str);
+                // qty 0 takes the order off the book
+                auto amd(int64_t id, order_side side, int64_t qty, double prc, uint32_t line_num = 0) -> void {
+                    _last_error = nullptr;
+
                     if(id <= 0) {
                         LOG_ERR(illegal_id, line_num);
                         return;
                     }
 
-                    auto side = extract_side(str);
                     if(order_side::MAX == side) {
                         LOG_ERR(illegal_side, line_num);
                         return;
                     }
 
-                    auto qty = extract_uint(str);
                     if(qty < 0) {
                         LOG_ERR(illegal_qty, line_num);
                         return;
                     }
 
-                    auto prc = extract_prc(str);
                     if(prc <= 0.0) {
                         LOG_ERR(illegal_prc, line_num);
                         return;
                     }
 
+                    if(_retired.contains(id)) { // nothing of it is left to amend
+                        LOG_ERR(over_amd, line_num);
+                        return;
+                    }
+
                     auto po = _orders.retrieve(id);
                     if(po->qty < 0) {
                         LOG_ERR(corrupted, line_num);
@@ -346,44 +610,148 @@ namespace toy {
                         if(verify_booked_order(po, side, prc, line_num)) {
                             auto old_book = po->book_qty;
                             po->book_qty = po->book_qty > 0 ? std::min(qty, po->book_qty) : qty;
-                            publish(&observer::amd, const_cast<order const*>(po), old_book);
+                            po->sched = _sched;
+                            po->ts = _ts;
+                            dispatch(order_action::amend, &observer::amd, const_cast<order const*>(po), old_book);
+                            if(!po->book_qty) {
+                                retire(id);
+                            }
                         }
                     }
                 }
 
-                auto handle_exe(const char* str, uint32_t line_num) -> void {
-                    auto iid = extract_uint(str);
+                auto exe(int64_t iid, int64_t exe_qty, double exe_prc, uint32_t line_num = 0) -> void {
+                    _last_error = nullptr;
+
                     if(iid <= 0) {
                         LOG_ERR(illegal_iid, line_num);
                         return;
                     }
 
-                    auto exe_qty = extract_uint(str);
                     if(exe_qty <= 0) {
                         LOG_ERR(illegal_qty, line_num);
                         return;
                     }
 
-                    auto exe_prc = extract_prc(str);
                     if(exe_prc <= 0.0) {
                         LOG_ERR(illegal_prc, line_num);
                         return;
                     }
 
-                    auto pt = _trades.create(_tid ++);
-                    pt->iid = iid;
-                    pt->qty = exe_qty;
-                    pt->prc = exe_prc;
-                    pt->side = order_side::MAX;
+                    // observers only see it during publish, no need to keep it
+                    trade t(_tid ++);
+                    t.iid = iid;
+                    t.qty = exe_qty;
+                    t.prc = exe_prc;
+                    t.side = order_side::MAX;
+                    t.sched = _sched;
+                    t.ts = _ts;
 
-                    publish(&observer::exe, const_cast<trade const*>(pt));
+                    dispatch(order_action::match, &observer::exe, const_cast<trade const*>(&t));
+                }
+
+            private:
+                template<typename ... ARGS>
+                auto dispatch(order_action act, void (observer::*func)(ARGS ...), ARGS ... args) -> void {
+                    profile::scope ps(profile::stage::dispatch, act);
+                    publish(func, args ...);
+                }
+
+                static auto clock() -> uint64_t {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+
+                // wait for the time line ts is due at, lines without timestamp are due with the previous one and
+                // those before the first timestamp right away. What the line publishes is stamped with ts the same
+                // way. False if the feeder was stopped while waiting, the line is then dropped
+                auto pace(uint64_t ts) -> bool {
+                    if(ts) {
+                        _ts = ts;
+                    }
+
+                    if(_speed <= 0.0) {
+                        return true;
+                    }
+
+                    if(!_sched) {
+                        if(!ts) {
+                            return true;
+                        }
+                        _sched = clock();
+                        _last_ts = ts;
+                    }
+
+                    if(ts > _last_ts) {
+                        auto gap = (int64_t)((ts - _last_ts) * 1000);
+                        if(_max_gap_ns > 0 && gap > _max_gap_ns) {
+                            gap = _max_gap_ns;
+                        }
+                        _sched += (uint64_t)(gap / _speed);
+                        _last_ts = ts;
+                    }
+
+                    // sleep while far off, a millisecond at a time with observers idle in between, spin the rest
+                    // for precision
+                    while(!_stop) {
+                        auto now = clock();
+                        if(now >= _sched) {
+                            return true;
+                        }
+                        if(_sched - now > 200000) {
+                            publish(&observer::idle);
+                            std::this_thread::sleep_for(std::chrono::nanoseconds(
+                                        std::min(_sched - now - 100000, (uint64_t)1000000)));
+                        }
+                    }
+                    return false;
                 }
 
                 auto handle_comment(const char* str, uint32_t line_num) -> void {
                     if(!_log_comment) {
                         return;
                     }
-                    log::info("    COMMENT -\t", line_num, "\t-" , str);
+                    TOY_LOG(info, feed, "    COMMENT -\t", line_num, "\t-" , str);
+                }
+
+                // instrument of an add or execution, false and counted if the line is dropped
+                auto subscribed(int64_t iid) -> bool {
+                    return _subscription.accepts(iid) || filter();
+                }
+
+                // order of a cancel or amend: added on a subscribed instrument, or not added yet, its line is then
+                // kept until the add tells the instrument
+                auto admitted(int64_t id) -> bool {
+                    if(_subscription.admitted(id)) {
+                        return true;
+                    }
+                    if(!_subscription.rejected(id) && !_retired.contains(id)) {
+                        auto po = _orders.find(id);
+                        if(!po || !po->qty) {
+                            return true;
+                        }
+                    }
+                    return filter();
+                }
+
+                // add on an instrument not subscribed to, what came of the order before it is dropped with it
+                auto reject(int64_t id) -> void {
+                    _subscription.reject(id);
+                    _orders.remove(id);
+                }
+
+                auto filter() -> bool {
+                    _last_error = nullptr;
+                    _filtered.store(_filtered.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); // single writer
+                    return false;
+                }
+
+                // nothing of it is left on the book: its record goes, its id stays known so late or repeated lines
+                // of it are still reported rather than taken for lines of a new order
+                auto retire(int64_t id) -> void {
+                    _orders.remove(id);
+                    _retired.insert(id);
+                    _subscription.release(id);
                 }
 
                 auto verify_booked_order(order* po, order_side side, double prc, int32_t line_num) -> bool {
@@ -408,16 +776,30 @@ namespace toy {
 
             private:
                 std::string _pathname;
+                tape_format _format = tape_format::csv;
                 bool _tolerant;
                 bool _log_comment;
 
-                bool _stop;
+                std::atomic<bool> _stop { false };
                 std::thread _thrd;
+                std::function<void()> _on_end;
 
                 trade::id_type _tid = 1;
 
-                order_container _orders;
-                trade_container _trades;
+                char const* _last_error = nullptr;
+                parse_errors _errors;
+
+                subscription _subscription;
+                std::atomic<uint64_t> _filtered { 0 };
+
+                double _speed = 0.0;
+                int64_t _max_gap_ns = 0;
+                uint64_t _ts = 0;       // of the tape, us, of the last line that had one
+                uint64_t _last_ts = 0;  // of the tape, us, paced up to
+                uint64_t _sched = 0;    // steady clock ns the current line is due at, 0 unless paced
+
+                order_container _orders; // live orders only, retired once nothing is left on the book
+                order_ids _retired;
         };
     }
 }
@@ -0,0 +1,279 @@
+#pragma once
+
+#include <cmath>
+#include <cstring>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "reference/order.hpp"
+
+namespace toy {
+    namespace feed {
+        namespace itch {
+
+            // ITCH-like binary capture: a stream of messages, each prefixed by its length (u16, excluding the
+            // prefix itself). Integers are big-endian, prices u32 with 4 implied decimals, timestamps u48 in ns.
+            // Every message starts with
+            //
+            //   0  type       u8
+            //   1  locate     u16   instrument id
+            //   3  timestamp  u48   0: due with the previous message
+            //
+            // and carries the fields of the tape line it stands for, checked the same way by the feeder:
+            //
+            //   A add      9 ref u64, 17 side u8 'B'/'S', 18 shares u32, 22 price u32     N,iid,ref,side,shares,price
+            //   D delete   9 ref u64, 17 side u8, 18 shares u32, 22 price u32            R,ref,side,shares,price
+            //   U replace  9 ref u64, 17 side u8, 18 shares u32, 22 price u32            M,ref,side,shares,price
+            //   E execute  9 shares u32, 13 price u32                                    X,iid,shares,price
+            //
+            // Delete carries the cancelled quantity and price, replace keeps the reference and only sets what is
+            // left, and executions are trade prints without order reference, as on the tape.
+
+            inline auto load_u16(char const* p) -> uint16_t {
+                uint16_t v; std::memcpy(&v, p, sizeof(v));
+                return __builtin_bswap16(v);
+            }
+
+            inline auto load_u32(char const* p) -> uint32_t {
+                uint32_t v; std::memcpy(&v, p, sizeof(v));
+                return __builtin_bswap32(v);
+            }
+
+            inline auto load_u64(char const* p) -> uint64_t {
+                uint64_t v; std::memcpy(&v, p, sizeof(v));
+                return __builtin_bswap64(v);
+            }
+
+            inline auto load_u48(char const* p) -> uint64_t {
+                return (uint64_t)load_u16(p) << 32 | load_u32(p + 2);
+            }
+
+            // typed views over a message in place, the buffer must outlive them
+            class message {
+                public:
+                    static uint16_t const header = 9;
+
+                    explicit message(char const* p) : _p(p) {}
+
+                    auto type() const { return *_p; }
+                    auto locate() const { return load_u16(_p + 1); }
+                    auto timestamp() const { return load_u48(_p + 3); }
+
+                protected:
+                    static auto price(char const* p) { return load_u32(p) / 10000.0; }
+
+                    static auto side(char c) {
+                        return 'B' == c ? reference::order_side::buy
+                            : 'S' == c ? reference::order_side::sell : reference::order_side::MAX;
+                    }
+
+                protected:
+                    char const* _p;
+            };
+
+            // add, delete and replace share one layout
+            class order_message : public message {
+                public:
+                    static uint16_t const size = header + 17;
+
+                    using message::message;
+
+                    auto ref() const { return load_u64(_p + 9); }
+                    auto side() const { return message::side(_p[17]); }
+                    auto shares() const { return load_u32(_p + 18); }
+                    auto price() const { return message::price(_p + 22); }
+            };
+
+            class add_order : public order_message {
+                public:
+                    static char const code = 'A';
+                    using order_message::order_message;
+            };
+
+            class delete_order : public order_message {
+                public:
+                    static char const code = 'D';
+                    using order_message::order_message;
+            };
+
+            class replace_order : public order_message {
+                public:
+                    static char const code = 'U';
+                    using order_message::order_message;
+            };
+
+            class execute : public message {
+                public:
+                    static char const code = 'E';
+                    static uint16_t const size = header + 8;
+
+                    using message::message;
+
+                    auto shares() const { return load_u32(_p + 9); }
+                    auto price() const { return message::price(_p + 13); }
+            };
+
+            // splits a buffer into messages and hands each to SINK::handle(VIEW const&, uint32_t seq) of its type.
+            // The handler and the expected length of every type are looked up in a table built at compile time;
+            // unknown types go to SINK::unknown(type, seq), known types of another length to SINK::malformed(seq).
+            template<typename SINK>
+            class decoder {
+                using handler = void (*)(SINK&, char const*, uint32_t);
+
+                struct table {
+                    handler fn[256];
+                    uint16_t size[256];
+                };
+
+                template<typename VIEW>
+                static auto handle(SINK& sink, char const* p, uint32_t seq) -> void {
+                    sink.handle(VIEW(p), seq);
+                }
+
+                template<typename VIEW>
+                static constexpr auto enter(table& t) -> void {
+                    t.fn[(uint8_t)VIEW::code] = &handle<VIEW>;
+                    t.size[(uint8_t)VIEW::code] = VIEW::size;
+                }
+
+                static constexpr auto make_table() -> table {
+                    table t {};
+                    enter<add_order>(t);
+                    enter<delete_order>(t);
+                    enter<replace_order>(t);
+                    enter<execute>(t);
+                    return t;
+                }
+
+                static constexpr table _table = make_table();
+
+                public:
+                    // complete messages of [data, data + len), seq counts them; returns the bytes consumed,
+                    // the rest is the start of a message to decode again with what follows
+                    static auto decode(char const* data, size_t len, SINK& sink, uint32_t& seq) -> size_t {
+                        auto pos = (size_t)0;
+                        while(pos + 2 <= len) {
+                            auto size = load_u16(data + pos);
+                            if(pos + 2 + size > len) {
+                                break;
+                            }
+
+                            auto p = data + pos + 2;
+                            pos += 2 + size;
+                            seq ++;
+
+                            if(!size) {
+                                sink.malformed(seq);
+                                continue;
+                            }
+
+                            auto type = (uint8_t)*p;
+                            if(!_table.fn[type]) {
+                                sink.unknown(type, seq);
+                            }
+                            else if(size != _table.size[type]) {
+                                sink.malformed(seq);
+                            }
+                            else {
+                                _table.fn[type](sink, p, seq);
+                            }
+                        }
+                        return pos;
+                    }
+            };
+
+            template<typename SINK>
+            constexpr typename decoder<SINK>::table decoder<SINK>::_table;
+
+            static size_t const chunk = 1 << 20; // holds the longest message, 2 + 65535 bytes
+
+            // a capture read a chunk at a time and handed to decode(data, len), which returns the bytes of the
+            // complete messages it consumed; a message cut by the end of a chunk is moved to the front and
+            // completed by the next read. Stops at the end of the stream or once stop() is true, returns the
+            // bytes left over, non-zero if the capture ends inside a message
+            template<typename DECODE, typename STOP>
+            auto read(std::istream& s, DECODE decode, STOP stop) -> size_t {
+                std::vector<char> buf(chunk);
+                auto kept = (size_t)0;
+
+                while(!stop()) {
+                    s.read(buf.data() + kept, buf.size() - kept);
+                    auto got = kept + (size_t)s.gcount();
+                    if(got == kept) {
+                        break;
+                    }
+
+                    auto used = decode(buf.data(), got);
+                    kept = got - used;
+                    std::memmove(buf.data(), buf.data() + used, kept);
+                }
+                return kept;
+            }
+
+            // appends messages to a capture, the inverse of the views
+            class encoder {
+                public:
+                    explicit encoder(std::string& out) : _out(out) {}
+
+                    auto add(uint16_t locate, uint64_t ts_ns, uint64_t ref, reference::order_side side,
+                            uint32_t shares, double prc) {
+                        order(add_order::code, locate, ts_ns, ref, side, shares, prc);
+                    }
+
+                    auto del(uint64_t ts_ns, uint64_t ref, reference::order_side side, uint32_t shares, double prc) {
+                        order(delete_order::code, 0, ts_ns, ref, side, shares, prc);
+                    }
+
+                    auto replace(uint64_t ts_ns, uint64_t ref, reference::order_side side, uint32_t shares,
+                            double prc) {
+                        order(replace_order::code, 0, ts_ns, ref, side, shares, prc);
+                    }
+
+                    auto exe(uint16_t locate, uint64_t ts_ns, uint32_t shares, double prc) {
+                        put_u16(execute::size);
+                        header(execute::code, locate, ts_ns);
+                        put_u32(shares);
+                        put_u32((uint32_t)std::llround(prc * 10000));
+                    }
+
+                private:
+                    auto order(char type, uint16_t locate, uint64_t ts_ns, uint64_t ref, reference::order_side side,
+                            uint32_t shares, double prc) -> void {
+                        put_u16(order_message::size);
+                        header(type, locate, ts_ns);
+                        put_u64(ref);
+                        _out.push_back(reference::order_side::buy == side ? 'B' : 'S');
+                        put_u32(shares);
+                        put_u32((uint32_t)std::llround(prc * 10000));
+                    }
+
+                    auto header(char type, uint16_t locate, uint64_t ts_ns) -> void {
+                        _out.push_back(type);
+                        put_u16(locate);
+                        put_u16((uint16_t)(ts_ns >> 32));
+                        put_u32((uint32_t)ts_ns);
+                    }
+
+                    auto put_u16(uint16_t v) -> void {
+                        v = __builtin_bswap16(v);
+                        _out.append((char const*)&v, sizeof(v));
+                    }
+
+                    auto put_u32(uint32_t v) -> void {
+                        v = __builtin_bswap32(v);
+                        _out.append((char const*)&v, sizeof(v));
+                    }
+
+                    auto put_u64(uint64_t v) -> void {
+                        v = __builtin_bswap64(v);
+                        _out.append((char const*)&v, sizeof(v));
+                    }
+
+                private:
+                    std::string& _out;
+            };
+
+        }
+    }
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+#include <atomic>
+
+#include "reference/order.hpp"
+
+namespace toy {
+    namespace feed {
+
+        // a set of order ids, a bit per id in pages allocated as ids reach them: an eighth of a byte per id and two
+        // loads per lookup. Pages stay once allocated, ids leaving the set never give memory back.
+        class order_ids {
+            static uint32_t const page_digits = 16;
+            static uint32_t const page_words = (1U << page_digits) / 64;
+
+            using page_type = std::unique_ptr<uint64_t[]>;
+
+            public:
+                auto insert(int64_t id) {
+                    if(auto pword = word(id, true)) {
+                        *pword |= bit(id);
+                    }
+                }
+
+                auto erase(int64_t id) {
+                    if(auto pword = word(id, false)) {
+                        *pword &= ~bit(id);
+                    }
+                }
+
+                auto contains(int64_t id) const {
+                    if(id < 0 || id > max_id) {
+                        return false;
+                    }
+                    auto page = (uint64_t)id >> page_digits;
+                    return page < _pages.size() && _pages[page] && (_pages[page][offset(id)] & bit(id));
+                }
+
+                // allocate the pages of ids [first, last] ahead of use
+                auto reserve(int64_t first, int64_t last) {
+                    for(auto id = first; id <= last; id += 1 << page_digits) {
+                        word(id, true);
+                    }
+                    word(last, true);
+                }
+
+                // bytes of pages, safe to read from any thread
+                auto memory() const { return _memory.load(std::memory_order_relaxed); }
+
+            private:
+                static int64_t const max_id = std::numeric_limits<reference::order_id>::max();
+
+                static auto bit(int64_t id) -> uint64_t { return (uint64_t)1 << (id % 64); }
+                static auto offset(int64_t id) -> uint32_t { return ((uint64_t)id & ((1U << page_digits) - 1)) / 64; }
+
+                auto word(int64_t id, bool allocate) -> uint64_t* {
+                    if(id < 0 || id > max_id) {
+                        return nullptr;
+                    }
+                    auto page = (uint64_t)id >> page_digits;
+                    if(page >= _pages.size()) {
+                        if(!allocate) {
+                            return nullptr;
+                        }
+                        _pages.resize(page + 1);
+                    }
+                    if(!_pages[page]) {
+                        if(!allocate) {
+                            return nullptr;
+                        }
+                        _pages[page].reset(new uint64_t[page_words]());
+                        _memory.fetch_add(page_words * sizeof(uint64_t), std::memory_order_relaxed);
+                    }
+                    return &_pages[page][offset(id)];
+                }
+
+            private:
+                std::vector<page_type> _pages;
+                std::atomic<size_t> _memory { 0 };
+        };
+
+    }
+}
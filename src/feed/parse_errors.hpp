@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <string>
+
+#include "log.hpp"
+
+namespace toy {
+    namespace feed {
+
+        enum struct parse_error : uint32_t {
+            illegal_ts = 0, illegal_act, illegal_msg, illegal_iid, illegal_id, illegal_side, illegal_qty, illegal_prc,
+            duplicated, duplicated_can, corrupted, over_can, over_amd, inconsistent_side, inconsistent_prc,
+            can_before_add, amd_before_add, // tolerated, warnings only
+            MAX
+        };
+
+        // lines of the tape per error category, counted by the feeder thread and readable from any thread.
+        // Detail lines go through a token bucket: burst lines at once, then rate lines per second; what the
+        // bucket drops is summed up per category at most once a second, so a corrupt tape does not replay
+        // at the speed of the log.
+        class parse_errors {
+            static uint32_t const categories = (uint32_t)parse_error::MAX;
+            static int64_t const summary_ns = 1000000000;
+
+            public:
+                static auto name(parse_error e) {
+                    static char const* const names[] = {
+                        "illegal_ts", "illegal_act", "illegal_msg", "illegal_iid", "illegal_id", "illegal_side",
+                        "illegal_qty", "illegal_prc", "duplicated", "duplicated_can", "corrupted", "over_can", "over_amd",
+                        "inconsistent_side", "inconsistent_prc", "can_before_add", "amd_before_add"
+                    };
+                    static_assert(sizeof(names) / sizeof(names[0]) == categories, "a name per category");
+                    return names[(uint32_t)e];
+                }
+
+                // rate <= 0: log every line. Call before the feed starts.
+                auto set_limit(double rate, uint32_t burst) {
+                    _rate = rate;
+                    _burst = std::max(burst, 1U);
+                    _tokens = _burst;
+                }
+
+                // feeder thread, true if the detail line of this one may be logged
+                auto record(parse_error e) -> bool {
+                    auto& n = _counts[(uint32_t)e]; // single writer
+                    n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                    if(_rate <= 0.0) {
+                        return true;
+                    }
+
+                    auto now = clock();
+                    if(_last_refill) {
+                        _tokens = std::min(_tokens + (now - _last_refill) * _rate / 1000000000, (double)_burst);
+                    }
+                    _last_refill = now;
+
+                    if(_tokens >= 1.0) {
+                        _tokens -= 1.0;
+                        return true;
+                    }
+
+                    if(!_suppressed ++) {
+                        _suppressed_since = now;
+                    }
+                    if(now - _suppressed_since >= summary_ns) {
+                        summary();
+                    }
+                    return false;
+                }
+
+                // any thread
+                auto count(parse_error e) const { return _counts[(uint32_t)e].load(std::memory_order_relaxed); }
+
+                auto total() const {
+                    auto total = (uint64_t)0;
+                    for(auto i = 0U; i < categories; i ++) {
+                        total += count((parse_error)i);
+                    }
+                    return total;
+                }
+
+                // non-zero categories as "name count ..."
+                auto to_string() const {
+                    std::ostringstream s;
+                    for(auto i = 0U; i < categories; i ++) {
+                        if(auto n = count((parse_error)i)) {
+                            s << (s.tellp() ? " " : "") << name((parse_error)i) << ' ' << n;
+                        }
+                    }
+                    return s.str();
+                }
+
+                // summary of lines not logged yet and totals per category, call after the feed stopped
+                auto report() {
+                    if(_suppressed) {
+                        summary();
+                    }
+                    if(total()) {
+                        TOY_LOG(warn, feed, "PARSING_ERRORS", to_string());
+                    }
+                }
+
+            private:
+                static auto clock() -> int64_t {
+                    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch()).count();
+                }
+
+                // categories counted since last summary, the suppressed lines are among them
+                auto summary() -> void {
+                    std::ostringstream s;
+                    for(auto i = 0U; i < categories; i ++) {
+                        auto n = count((parse_error)i);
+                        if(n != _summarized[i]) {
+                            s << ' ' << name((parse_error)i) << ' ' << n - _summarized[i];
+                            _summarized[i] = n;
+                        }
+                    }
+                    TOY_LOG(warn, feed, "PARSING_ERR  -", _suppressed, "lines not logged, counted since last summary:" + s.str());
+                    _suppressed = 0;
+                }
+
+            private:
+                std::atomic<uint64_t> _counts[categories] {};
+                uint64_t _summarized[categories] {};
+
+                double _rate = 0.0;  // tokens per second
+                uint32_t _burst = 1;
+                double _tokens = 1.0;
+                int64_t _last_refill = 0;
+
+                uint64_t _suppressed = 0;
+                int64_t _suppressed_since = 0;
+        };
+
+    }
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+#include "reference/instrument.hpp"
+#include "order_ids.hpp"
+
+namespace toy {
+    namespace feed {
+
+        // instruments a feeder passes on, checked as soon as a line's instrument id is read: a bit per id below
+        // dense_ids, sorted ranges above, so a range as wide as the id space costs no more than a single id.
+        // Cancels and amends carry no instrument id, they pass while their order, added on a subscribed
+        // instrument, is on the book; orders added on other instruments are remembered to drop theirs.
+        class subscription {
+            static int64_t const dense_ids = 1 << 16;
+
+            public:
+                // nothing subscribed: every instrument passes
+                auto subscribe(reference::instrument_range r) {
+                    for(auto iid = (int64_t)r.first; iid <= std::min((int64_t)r.last, dense_ids - 1); iid ++) {
+                        if((uint64_t)iid / 64 >= _iids.size()) {
+                            _iids.resize(iid / 64 + 1);
+                        }
+                        _iids[iid / 64] |= bit(iid);
+                    }
+                    if(r.last >= dense_ids) {
+                        add_range({ std::max(r.first, (reference::instrument_id)dense_ids), r.last });
+                    }
+                    _active = true;
+                }
+
+                auto active() const { return _active; }
+
+                auto accepts(int64_t iid) const {
+                    if(!_active) {
+                        return true;
+                    }
+                    if(iid < 0) {
+                        return false;
+                    }
+                    if(iid < dense_ids) {
+                        return (uint64_t)iid / 64 < _iids.size() && (_iids[iid / 64] & bit(iid));
+                    }
+                    auto it = std::upper_bound(_ranges.begin(), _ranges.end(), iid,
+                            [](int64_t iid, reference::instrument_range const& r) { return iid < r.first; });
+                    return _ranges.begin() != it && iid <= (-- it)->last;
+                }
+
+                // an order accepted on a subscribed instrument, its cancels and amends pass until it is released
+                auto admit(int64_t id) {
+                    if(_active) {
+                        _admitted.insert(id);
+                    }
+                }
+
+                // nothing of the order is left on the book
+                auto release(int64_t id) {
+                    if(_active) {
+                        _admitted.erase(id);
+                    }
+                }
+
+                auto admitted(int64_t id) const {
+                    return !_active || _admitted.contains(id);
+                }
+
+                // an order added on an instrument not subscribed to
+                auto reject(int64_t id) {
+                    if(_active) {
+                        _rejected.insert(id);
+                    }
+                }
+
+                auto rejected(int64_t id) const {
+                    return _active && _rejected.contains(id);
+                }
+
+                // bytes of order ids, safe to read from any thread
+                auto memory() const { return _admitted.memory() + _rejected.memory(); }
+
+            private:
+                static auto bit(int64_t n) -> uint64_t { return (uint64_t)1 << (n % 64); }
+
+                // kept sorted and disjoint, overlapping and adjacent ranges are merged
+                auto add_range(reference::instrument_range r) -> void {
+                    _ranges.push_back(r);
+                    std::sort(_ranges.begin(), _ranges.end(),
+                            [](reference::instrument_range const& l, reference::instrument_range const& r) {
+                                return l.first < r.first;
+                            });
+                    auto out = _ranges.begin();
+                    for(auto it = _ranges.begin() + 1; it < _ranges.end(); it ++) {
+                        if((int64_t)it->first <= (int64_t)out->last + 1) {
+                            out->last = std::max(out->last, it->last);
+                        }
+                        else {
+                            *(++ out) = *it;
+                        }
+                    }
+                    _ranges.erase(out + 1, _ranges.end());
+                }
+
+            private:
+                bool _active = false;
+                std::vector<uint64_t> _iids;
+                std::vector<reference::instrument_range> _ranges;
+                order_ids _admitted;
+                order_ids _rejected;
+        };
+
+    }
+}
@@ -1,20 +1,45 @@
 
 #include <memory>
 #include <iostream>
+#include <future>
 
 #include <signal.h>
+#include <semaphore.h>
 
 #include "config.hpp"
 #include "log.hpp"
+#include "thread.hpp"
+#include "profile.hpp"
+#include "engine.hpp"
 #include "./feed/feeder_file.hpp"
+#include "./feed/ring.hpp"
 #include "./order_book/manager.hpp"
+#include "./bar/aggregator.hpp"
+#include "./control/server.hpp"
+#include "./warmup/warmup.hpp"
+#include "./batch/batch.hpp"
 
 using namespace toy;
 using feed::feeder;
 
-static bool _terminate = false;
+static std::atomic<bool> _terminate { false };
+static sem_t _terminated; // sem_post is async-signal-safe
 auto SIGTERM_handler(int sig) -> void {
     _terminate = true;
+    sem_post(&_terminated);
+}
+
+auto make_thread_policy(config const& cfg, std::string const& name, thread_policy& policy) {
+    if(!cfg.try_get("thread_" + name + "_cpu", policy.cpu)) {
+        policy.cpu = -1;
+    }
+
+    std::string sched;
+    if(cfg.try_get("thread_" + name + "_sched", sched) && !policy.parse_sched(sched)) {
+        log::error("thread_" + name + "_sched must be one of default, fifo:<prio>, nice:<n>");
+        return false;
+    }
+    return true;
 }
 
 auto init_log(config const& cfg) {
@@ -22,6 +47,26 @@ auto init_log(config const& cfg) {
     if(cfg.try_get("log_severity", sev)) {
         log::init(sev);
     }
+
+    for(auto i = 0U; i < (uint32_t)log::module::MAX; i ++) {
+        std::string own;
+        if(cfg.try_get(std::string("log_severity_") + log::name((log::module)i), own) && !own.empty()) {
+            log::init((log::module)i, std::atoi(own.c_str()));
+        }
+    }
+}
+
+// empty: every instrument
+auto make_subscription(config const& cfg, std::vector<reference::instrument_range>& ranges) {
+    std::string list;
+    if(!cfg.try_get("feeder_subscription", list)) {
+        list.clear();
+    }
+    if(!reference::parse_instrument_ids(list, ranges)) {
+        log::error("feeder_subscription must be instrument ids and ranges like 1,5,10-20");
+        return false;
+    }
+    return true;
 }
 
 auto make_feeder(config const& cfg) {
@@ -31,6 +76,15 @@ auto make_feeder(config const& cfg) {
         return (feed::feeder_file*)(nullptr);
     }
 
+    std::string format;
+    if(!cfg.try_get("feeder_format", format)) {
+        format = "csv";
+    }
+    if(format != "csv" && format != "itch") {
+        log::error("feeder_format must be csv or itch");
+        return (feed::feeder_file*)(nullptr);
+    }
+
     bool tolerant;
     if(!cfg.try_get("feeder_tolerant", tolerant)) {
         tolerant = true;
@@ -41,38 +95,424 @@ auto make_feeder(config const& cfg) {
         log_comment = false;
     }
 
-    return new feed::feeder_file(ffile, tolerant, log_comment);
+    std::vector<reference::instrument_range> subscription;
+    if(!make_subscription(cfg, subscription)) {
+        return (feed::feeder_file*)(nullptr);
+    }
+
+    thread_policy policy;
+    if(!make_thread_policy(cfg, "feeder", policy)) {
+        return (feed::feeder_file*)(nullptr);
+    }
+
+    double speed;
+    if(!cfg.try_get("feeder_pace_speed", speed)) {
+        speed = 0.0;
+    }
+
+    int64_t max_gap_us;
+    if(!cfg.try_get("feeder_pace_max_gap_us", max_gap_us)) {
+        max_gap_us = 0;
+    }
+    if(max_gap_us < 0) {
+        log::error("feeder_pace_max_gap_us must be greater equal to 0");
+        return (feed::feeder_file*)(nullptr);
+    }
+
+    double error_rate;
+    if(!cfg.try_get("feeder_error_log_rate", error_rate)) {
+        error_rate = 100.0;
+    }
+
+    int32_t error_burst;
+    if(!cfg.try_get("feeder_error_log_burst", error_burst)) {
+        error_burst = 1000;
+    }
+    if(error_burst <= 0) {
+        log::error("feeder_error_log_burst must be greater than 0");
+        return (feed::feeder_file*)(nullptr);
+    }
+
+    auto pfeeder = new feed::feeder_file(ffile, tolerant, log_comment);
+    pfeeder->set_format(format == "itch" ? feed::tape_format::itch : feed::tape_format::csv);
+    pfeeder->set_thread_policy(policy);
+    pfeeder->set_pace(speed, max_gap_us);
+    pfeeder->subscribe(subscription);
+    pfeeder->errors().set_limit(error_rate, error_burst);
+    pfeeder->set_on_end([]() { SIGTERM_handler(SIGTERM); });
+    return pfeeder;
 }
 
-auto make_order_book(config const& cfg) {
-    int32_t lev;
-    if(!cfg.try_get("order_book_level", lev)) {
-        lev = 5;
+// order_book_* settings, shared by the live pipeline and batch replay
+auto make_engine_options(config const& cfg, engine_options& opt) {
+    if(!cfg.try_get("order_book_level", opt.max_lev)) {
+        opt.max_lev = 5;
     }
-    if(lev <= 0 || lev > 10) {
-        log::error("order_book_level must be in range [1 - 10]");
-        return (order_book::manager*)nullptr;
+    if(opt.max_lev <= 0 || opt.max_lev > 1000) {
+        log::error("order_book_level must be in range [1 - 1000]");
+        return false;
     }
 
-    int32_t interval;
-    if(!cfg.try_get("order_book_interval", interval)) {
-        interval = 10;
+    if(!cfg.try_get("order_book_interval", opt.interval)) {
+        opt.interval = 10;
     }
-    if(interval <= 0) {
+    if(opt.interval <= 0) {
         log::error("order_book_interval must be greater than 0");
-        return (order_book::manager*)nullptr;
+        return false;
     }
 
-    int32_t tolerance;
-    if(!cfg.try_get("order_book_tolerance", tolerance)) {
-        tolerance = 10;
+    if(!cfg.try_get("order_book_tolerance", opt.tolerance)) {
+        opt.tolerance = 10;
     }
-    if(tolerance < 0) {
+    if(opt.tolerance < 0) {
         log::error("order_book_tolerance must be greater equal to 0");
+        return false;
+    }
+
+    if(!cfg.try_get("order_book_l3", opt.l3)) {
+        opt.l3 = false;
+    }
+
+    if(!cfg.try_get("order_book_snapshot", opt.snapshot)) {
+        opt.snapshot = 0;
+    }
+    if(opt.snapshot < 0) {
+        log::error("order_book_snapshot must be greater equal to 0");
+        return false;
+    }
+
+    if(!cfg.try_get("order_book_conflate_us", opt.conflate_us)) {
+        opt.conflate_us = 0;
+    }
+    if(opt.conflate_us < 0) {
+        log::error("order_book_conflate_us must be greater equal to 0");
+        return false;
+    }
+
+    if(!cfg.try_get("order_book_analytics", opt.analytics)) {
+        opt.analytics = false;
+    }
+
+    std::string storage_name;
+    if(!cfg.try_get("order_book_storage", storage_name)) {
+        storage_name = "map";
+    }
+    if(!reference::parse_book_storage(storage_name, opt.storage)) {
+        log::error("order_book_storage must be map or flat");
+        return false;
+    }
+
+    std::string instruments;
+    if(!cfg.try_get("order_book_instruments", instruments)) {
+        instruments.clear();
+    }
+
+    if(!instruments.empty() && !reference::load_instruments(instruments, opt.max_lev, opt.storage, opt.instruments)) {
+        return false;
+    }
+    return true;
+}
+
+auto make_order_book(config const& cfg) {
+    engine_options opt;
+    if(!make_engine_options(cfg, opt)) {
         return (order_book::manager*)nullptr;
     }
 
-    return new order_book::manager(lev, interval, tolerance);
+    std::unique_ptr<order_book::manager> pbook(new order_book::manager(opt.max_lev, opt.interval, opt.tolerance, opt.l3,
+            opt.snapshot, opt.conflate_us));
+    pbook->set_analytics(opt.analytics);
+    pbook->set_storage(opt.storage);
+    for(auto const& spec : opt.instruments) {
+        if(!pbook->provision(spec)) {
+            log::error("failed to provision instrument", spec.iid, "- duplicated or depth over", reference::max_market_depth);
+            return (order_book::manager*)nullptr;
+        }
+    }
+
+    return pbook.release();
+}
+
+auto make_bar(config const& cfg, bar::sink* psink) {
+    int64_t time_us;
+    if(!cfg.try_get("bar_time_us", time_us)) {
+        time_us = 0;
+    }
+
+    int64_t volume;
+    if(!cfg.try_get("bar_volume", volume)) {
+        volume = 0;
+    }
+
+    int32_t ticks;
+    if(!cfg.try_get("bar_ticks", ticks)) {
+        ticks = 0;
+    }
+
+    if(time_us <= 0 && volume <= 0 && ticks <= 0) {
+        return (bar::aggregator*)nullptr;
+    }
+
+    return new bar::aggregator(psink, time_us, volume, ticks);
+}
+
+auto make_ring(config const& cfg) {
+    int32_t size;
+    if(!cfg.try_get("feeder_ring_size", size) || !size) {
+        return (feed::ring*)nullptr;
+    }
+    if(size < 0 || (size & (size - 1))) {
+        log::error("feeder_ring_size must be 0 or a power of 2");
+        return (feed::ring*)nullptr;
+    }
+
+    return new feed::ring(size);
+}
+
+// observers run on the feeder thread, or on their own ring consumer thread when a ring is configured
+auto attach(config const& cfg, feed::feeder* pfeeder, feed::ring* pring, std::string const& name, feed::observer* pob) {
+    if(!pring) {
+        pfeeder->register_observer(pob);
+        return true;
+    }
+
+    thread_policy policy;
+    if(!make_thread_policy(cfg, name, policy)) {
+        return false;
+    }
+    pring->attach(name, pob, policy);
+    return true;
+}
+
+// before the feed starts, see warmup
+auto warm_up(config const& cfg, feed::feeder_file* pfeeder, order_book::manager* pbook) {
+    bool lock;
+    if(cfg.try_get("warmup_mlock", lock) && lock) {
+        warmup::lock_memory();
+    }
+
+    int32_t order_ids;
+    if(cfg.try_get("warmup_order_ids", order_ids) && order_ids > 0) {
+        pfeeder->reserve(order_ids);
+        pbook->reserve(order_ids);
+    }
+
+    int32_t events;
+    if(!cfg.try_get("warmup_events", events) || events <= 0) {
+        return true;
+    }
+
+    auto sev = log::level();
+    log::init(4); // throwaway pair, configuration is logged already
+    std::unique_ptr<feed::feeder_file> pfeeder_warm(make_feeder(cfg));
+    std::unique_ptr<order_book::manager> pbook_warm(make_order_book(cfg));
+    log::init(sev);
+    if(!pfeeder_warm || !pbook_warm) {
+        return false;
+    }
+
+    warmup::prime(pfeeder_warm.get(), pbook_warm.get(), pbook->specs(), events);
+    return true;
+}
+
+auto module(std::string const& name, log::module& mod) {
+    for(auto i = 0U; i < (uint32_t)log::module::MAX; i ++) {
+        if(name == log::name((log::module)i)) {
+            mod = (log::module)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+auto make_control(config const& cfg, feed::feeder* pfeeder, feed::parse_errors const* perrors,
+        order_book::manager* pbook, feed::ring const* pring) {
+    std::string pathname;
+    if(!cfg.try_get("control_socket", pathname) || pathname.empty()) {
+        return (control::server*)nullptr;
+    }
+
+    thread_policy policy;
+    if(!make_thread_policy(cfg, "control", policy)) {
+        return (control::server*)nullptr;
+    }
+
+    std::unique_ptr<control::server> pctrl(new control::server(pathname, policy));
+
+    pctrl->register_command("set", [pbook](std::istream& s) -> std::string {
+        std::string key; int32_t val; log::module mod;
+        if(!(s >> key >> val)) {
+            return "ERR usage: set <order_book_interval|order_book_tolerance|log_severity[_<module>]> <value>";
+        }
+
+        if(key == "order_book_interval" && val > 0) {
+            pbook->set_interval(val);
+        }
+        else if(key == "order_book_tolerance" && val >= 0) {
+            pbook->set_tolerance(val);
+        }
+        else if(key == "log_severity" && val >= 0 && val <= 3) {
+            log::init(val);
+        }
+        else if(key.compare(0, 13, "log_severity_") == 0 && val >= -1 && val <= 4 && module(key.substr(13), mod)) {
+            log::init(mod, val);
+        }
+        else {
+            return "ERR invalid item " + key;
+        }
+        return "OK";
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    pctrl->register_command("stats", [pfeeder, perrors, pbook, pring, start](std::istream&) -> std::string {
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::ostringstream s;
+        auto total = 0UL;
+        char const* names[] = { "add", "can", "amd", "exe" };
+        for(auto i = 0U; i < 4; i ++) {
+            s << names[i] << ' ' << pbook->messages(i) << '\n';
+            total += pbook->messages(i);
+        }
+        s << "total " << total << ' ' << (uint64_t)(total / elapsed) << "/s\n";
+        s << "rejected " << pbook->rejected() << '\n';
+        s << "parse_errors " << perrors->total() << ' ' << perrors->to_string() << '\n';
+        s << "memory feeder " << pfeeder->memory() << " order_book " << pbook->memory() << '\n';
+        if(pring) {
+            for(auto const& pc : pring->consumers()) {
+                s << "ring " << pc->name() << " lag " << pc->lag() << " max_lag " << pc->max_lag() << '\n';
+            }
+        }
+
+        // instruments are owned by the feeder thread
+        auto pdone = std::make_shared<std::promise<std::string>>();
+        pbook->post([pbook, pdone]() {
+            std::ostringstream s;
+            pbook->stats(s);
+            pdone->set_value(s.str());
+        });
+
+        auto fut = pdone->get_future();
+        if(std::future_status::ready != fut.wait_for(std::chrono::seconds(1))) {
+            s << "instruments unavailable, feed is idle";
+        }
+        else {
+            s << fut.get();
+        }
+        return s.str();
+    });
+
+    pctrl->register_command("snapshot", [pbook](std::istream& s) -> std::string {
+        std::vector<reference::instrument_id> iids;
+        reference::instrument_id iid;
+        while(s >> iid) {
+            iids.push_back(iid);
+        }
+        if(iids.empty()) {
+            return "ERR usage: snapshot <iid> ...";
+        }
+
+        pbook->post([pbook, iids]() {
+            for(auto iid : iids) {
+                if(!pbook->snapshot(iid)) {
+                    log::warn("snapshot unavailable", iid);
+                }
+            }
+        });
+        return "OK";
+    });
+
+    pctrl->register_command("analytics", [pbook](std::istream&) -> std::string {
+        auto pdone = std::make_shared<std::promise<std::string>>();
+        pbook->post([pbook, pdone]() {
+            std::ostringstream s;
+            pbook->sample(s);
+            pdone->set_value(s.str());
+        });
+
+        auto fut = pdone->get_future();
+        if(std::future_status::ready != fut.wait_for(std::chrono::seconds(1))) {
+            return "ERR instruments unavailable, feed is idle";
+        }
+        return fut.get();
+    });
+
+    pctrl->register_command("depth", [pbook](std::istream& s) -> std::string {
+        reference::instrument_id iid; char ch; double prc; int64_t qty;
+        if(!(s >> iid >> ch >> prc >> qty) || ('B' != ch && 'S' != ch)) {
+            return "ERR usage: depth <iid> <B|S> <prc> <qty>";
+        }
+        auto side = 'B' == ch ? reference::order_side::buy : reference::order_side::sell;
+
+        auto pdone = std::make_shared<std::promise<std::string>>();
+        pbook->post([pbook, pdone, iid, side, prc, qty]() {
+            std::ostringstream s;
+            s << "at " << pbook->depth_at(iid, side, prc) << " through " << pbook->depth_through(iid, side, prc)
+                << " fill_price " << pbook->fill_price(iid, side, qty);
+            pdone->set_value(s.str());
+        });
+
+        auto fut = pdone->get_future();
+        if(std::future_status::ready != fut.wait_for(std::chrono::seconds(1))) {
+            return "ERR instruments unavailable, feed is idle";
+        }
+        return fut.get();
+    });
+
+    if(!pctrl->start()) {
+        return (control::server*)nullptr;
+    }
+    return pctrl.release();
+}
+
+// every tape of batch_tapes through an engine of its own built from the same settings, instead of the live pipeline
+auto run_batch(config const& cfg, std::string const& pathname) {
+    engine_options opt;
+    if(!make_engine_options(cfg, opt)) {
+        return false;
+    }
+    if(!cfg.try_get("feeder_tolerant", opt.tolerant)) {
+        opt.tolerant = true;
+    }
+    if(!make_subscription(cfg, opt.subscription)) {
+        return false;
+    }
+
+    std::string format;
+    if(!cfg.try_get("feeder_format", format)) {
+        format = "csv";
+    }
+    if(format != "csv" && format != "itch") {
+        log::error("feeder_format must be csv or itch");
+        return false;
+    }
+
+    int32_t jobs;
+    if(!cfg.try_get("batch_jobs", jobs)) {
+        jobs = 0;
+    }
+    if(jobs < 0) {
+        log::error("batch_jobs must be greater equal to 0");
+        return false;
+    }
+
+    std::string output_dir;
+    if(!cfg.try_get("batch_output_dir", output_dir)) {
+        output_dir.clear();
+    }
+
+    std::vector<std::string> tapes;
+    if(!batch::list(pathname, tapes)) {
+        return false;
+    }
+
+    // published data goes to the outputs, the log keeps warnings unless told otherwise
+    std::string own;
+    if(!cfg.try_get("log_severity_order_book", own) || own.empty()) {
+        log::init(log::module::order_book, 2);
+    }
+
+    return batch(opt, format == "itch", output_dir, jobs).run(tapes, _terminate);
 }
 
 auto main(int32_t argc, char** argv) -> int32_t {
@@ -83,6 +523,7 @@ auto main(int32_t argc, char** argv) -> int32_t {
 
     log::info("+++++++++++++++", argv[0], "started +++++++++++++");
 
+    sem_init(&_terminated, 0, 0);
     if(SIG_ERR == signal(SIGTERM, SIGTERM_handler)) {
         log::error("failed to install SIGTERM handler");
         return 1;
@@ -90,7 +531,37 @@ auto main(int32_t argc, char** argv) -> int32_t {
 
     config cfg(argv[1]);
     init_log(cfg);
-    std::unique_ptr<feed::feeder> pfeeder(make_feeder(cfg));
+
+    bool prof;
+    if(cfg.try_get("profile", prof)) {
+        profile::init(prof);
+    }
+
+    thread_policy main_policy;
+    if(!make_thread_policy(cfg, "main", main_policy)) {
+        return 1;
+    }
+
+    // block: sleep until terminated; busy: spin on the flag, keeps the core hot at the cost of burning it
+    std::string wait;
+    if(!cfg.try_get("thread_main_wait", wait)) {
+        wait = "block";
+    }
+    if(wait != "block" && wait != "busy") {
+        log::error("thread_main_wait must be block or busy");
+        return 1;
+    }
+
+    std::string tapes;
+    if(cfg.try_get("batch_tapes", tapes) && !tapes.empty()) {
+        auto ok = run_batch(cfg, tapes);
+        profile::report();
+        log::info("---------------", argv[0], "stopped ---------------");
+        return ok ? 0 : 1;
+    }
+
+    auto pfeeder_file = make_feeder(cfg);
+    std::unique_ptr<feed::feeder> pfeeder(pfeeder_file);
     if(!pfeeder) {
         return 1;
     }
@@ -100,16 +571,66 @@ auto main(int32_t argc, char** argv) -> int32_t {
         return 1;
     }
 
-    pfeeder->register_observer(pbook.get());
+    std::unique_ptr<feed::ring> pring(make_ring(cfg));
+    if(pring) {
+        pfeeder->register_observer(pring.get());
+    }
 
+    if(!attach(cfg, pfeeder.get(), pring.get(), "book", pbook.get())) {
+        return 1;
+    }
+
+    bar::log_sink bar_sink;
+    std::unique_ptr<bar::aggregator> pbar(make_bar(cfg, &bar_sink));
+    if(pbar && !attach(cfg, pfeeder.get(), pring.get(), "bar", pbar.get())) {
+        return 1;
+    }
+
+    std::unique_ptr<control::server> pctrl(make_control(cfg, pfeeder.get(), &pfeeder_file->errors(), pbook.get(),
+            pring.get()));
+
+    if(!warm_up(cfg, pfeeder_file, pbook.get())) {
+        return 1;
+    }
+
+    if(pring) {
+        pring->start();
+    }
     pfeeder->start();
+    main_policy.apply("main"); // once the others started, they do not inherit it
 
-    while(!_terminate) {
-        // log.flush() ....
-        std::this_thread::sleep_for(std::chrono::seconds(1));
+    if(wait == "busy") {
+        while(!_terminate.load(std::memory_order_relaxed)) {
+        }
+    }
+    else {
+        while(!_terminate) {
+            sem_wait(&_terminated);
+        }
     }
 
     pfeeder->stop();
+    pfeeder_file->errors().report();
+    if(auto filtered = pfeeder_file->filtered()) {
+        TOY_LOG(info, feed, "FILTERED", filtered, "lines of instruments not subscribed to");
+    }
+
+    if(pring) {
+        pring->stop(); // drains what the feeder published
+    }
+
+    if(pctrl) {
+        pctrl->stop();
+    }
+
+    if(pbar) {
+        pbar->flush();
+    }
+
+    pbook->flush();
+    pbook->report_health();
+    pbook->report_delay();
+    profile::report();
 
     log::info("---------------", argv[0], "stopped ---------------");
 
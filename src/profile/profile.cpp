@@ -0,0 +1,6 @@
+
+#include "profile.hpp"
+
+namespace toy {
+    profile profile::_instance;
+}
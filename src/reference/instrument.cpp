@@ -0,0 +1,96 @@
+
+#include <fstream>
+#include <sstream>
+#include <limits>
+
+#include "log.hpp"
+#include "reference/instrument.hpp"
+
+namespace toy {
+    namespace reference {
+
+        auto parse_book_storage(std::string const& name, book_storage& storage) -> bool {
+            if("map" == name) {
+                storage = book_storage::map;
+            }
+            else if("flat" == name) {
+                storage = book_storage::flat;
+            }
+            else {
+                return false;
+            }
+            return true;
+        }
+
+        auto parse_instrument_ids(std::string const& list, std::vector<instrument_range>& ranges) -> bool {
+            std::istringstream s(list);
+            std::string item;
+            while(std::getline(s, item, ',')) {
+                std::istringstream ss(item);
+                int64_t first, last;
+                char dash;
+                if(!(ss >> first) || first <= 0) {
+                    return false;
+                }
+                last = first;
+                if(ss >> dash && ('-' != dash || !(ss >> last) || last < first)) {
+                    return false;
+                }
+                if(!(ss >> std::ws).eof() || last > std::numeric_limits<instrument_id>::max()) {
+                    return false;
+                }
+                ranges.push_back({ (instrument_id)first, (instrument_id)last });
+            }
+            return true;
+        }
+
+        auto load_instruments(std::string const& pathname, int32_t default_depth,
+                book_storage default_storage, std::vector<instrument_spec>& specs) -> bool {
+            std::ifstream s(pathname);
+            if(!s.good()) {
+                TOY_LOG(error, reference, "failed to open instrument master", pathname);
+                return false;
+            }
+
+            auto line_num = 0;
+            std::string line;
+            while(std::getline(s, line)) {
+                line_num ++;
+                if(line.empty() || '#' == line[0]) {
+                    continue;
+                }
+
+                std::istringstream ss(line);
+                instrument_spec spec;
+                char d0, d1, d2, d3, d4;
+                if(!(ss >> spec.iid >> d0 >> spec.tick >> d1 >> spec.min_prc >> d2 >> spec.max_prc >> d3 >> spec.depth)
+                        || ',' != d0 || ',' != d1 || ',' != d2 || ',' != d3) {
+                    TOY_LOG(error, reference, "instrument master", pathname, "line", line_num, "malformed -", line);
+                    return false;
+                }
+
+                spec.storage = default_storage;
+                std::string storage;
+                if(ss >> d4 && (',' != d4 || !(ss >> storage) || !parse_book_storage(storage, spec.storage))) {
+                    TOY_LOG(error, reference, "instrument master", pathname, "line", line_num, "malformed -", line);
+                    return false;
+                }
+
+                if(!spec.iid || spec.tick < 0.0 || spec.min_prc < 0.0 || spec.max_prc < 0.0 || spec.depth < 0
+                        || (spec.max_prc > 0.0 && spec.max_prc < spec.min_prc)) {
+                    TOY_LOG(error, reference, "instrument master", pathname, "line", line_num, "invalid -", line);
+                    return false;
+                }
+
+                if(!spec.depth) {
+                    spec.depth = default_depth;
+                }
+                specs.push_back(spec);
+            }
+
+            TOY_LOG(info, reference, "instrument master", pathname, "loaded", specs.size(), "instruments");
+            return true;
+        }
+
+    }
+}
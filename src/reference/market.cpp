@@ -4,7 +4,41 @@
 namespace toy {
     namespace reference {
 
-        level const market::empty_lev { 0, 0.0, 0, 0.0 };
+        template<uint32_t N> auto make_fixed_market(instrument_id iid, uint32_t max_lev) -> market* {
+            return new fixed_market<N>(iid, max_lev);
+        }
+
+        template<uint32_t N> auto make_fixed_market_at(void* where, instrument_id iid, uint32_t max_lev) -> market* {
+            return new(where) fixed_market<N>(iid, max_lev);
+        }
+
+        template<uint32_t N> auto fixed_market_layout() -> market_layout {
+            return { sizeof(fixed_market<N>), make_fixed_market_at<N> };
+        }
+
+        auto make_market_factory(uint32_t max_lev) -> market_factory {
+            if(max_lev <= 8) return make_fixed_market<8>;
+            if(max_lev <= 16) return make_fixed_market<16>;
+            if(max_lev <= 32) return make_fixed_market<32>;
+            if(max_lev <= 64) return make_fixed_market<64>;
+            if(max_lev <= 128) return make_fixed_market<128>;
+            if(max_lev <= 256) return make_fixed_market<256>;
+            if(max_lev <= 512) return make_fixed_market<512>;
+            if(max_lev <= max_market_depth) return make_fixed_market<max_market_depth>;
+            return nullptr;
+        }
+
+        auto make_market_layout(uint32_t max_lev) -> market_layout {
+            if(max_lev <= 8) return fixed_market_layout<8>();
+            if(max_lev <= 16) return fixed_market_layout<16>();
+            if(max_lev <= 32) return fixed_market_layout<32>();
+            if(max_lev <= 64) return fixed_market_layout<64>();
+            if(max_lev <= 128) return fixed_market_layout<128>();
+            if(max_lev <= 256) return fixed_market_layout<256>();
+            if(max_lev <= 512) return fixed_market_layout<512>();
+            if(max_lev <= max_market_depth) return fixed_market_layout<max_market_depth>();
+            return { 0, nullptr };
+        }
 
     }
 }
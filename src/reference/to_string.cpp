@@ -5,6 +5,8 @@
 
 #include "reference/order.hpp"
 #include "reference/market.hpp"
+#include "reference/delta.hpp"
+#include "reference/signals.hpp"
 
 using toy::reference::order_side;
 
@@ -48,3 +50,22 @@ auto operator<<(std::ostream& s, toy::reference::market const* pm) -> std::ostre
 
     return s;
 }
+
+auto operator<<(std::ostream& s, toy::reference::market_delta const* pd) -> std::ostream& {
+    s << "product: " << pd->iid() << " delta " << pd->size();
+    for(auto const& d : *pd) {
+        s << "\n  " << (char)d.act << ' ' << d.side;
+        switch(d.act) {
+        case toy::reference::delta_action::remove: s << ' ' << d.lev; break;
+        case toy::reference::delta_action::trade: s << ' ' << d.qty << '@' << d.prc; break;
+        default: s << ' ' << d.lev << ' ' << d.qty << '@' << d.prc; break;
+        }
+    }
+    return s;
+}
+
+auto operator<<(std::ostream& s, toy::reference::signals const* ps) -> std::ostream& {
+    return s << "product: " << ps->iid << " spread " << ps->spread << " mid " << ps->mid << " microprice "
+            << ps->microprice << " imbalance " << ps->imbalance << " ofi " << ps->ofi << " volume " << ps->volume
+            << " vwap " << ps->vwap;
+}
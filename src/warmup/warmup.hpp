@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+#include <sys/mman.h>
+
+#include "log.hpp"
+#include "../feed/feeder_file.hpp"
+#include "order_book/manager.hpp"
+
+namespace toy {
+
+    // runs before the feed starts, so the first real messages do not pay for page faults,
+    // first-time allocations and cold caches.
+    class warmup {
+        static uint32_t const batch = 1000;
+
+        public:
+            // lock everything mapped now and later, faults then happen at allocation instead of first touch
+            static auto lock_memory() {
+                if(mlockall(MCL_CURRENT | MCL_FUTURE) < 0) {
+                    log::warn("warmup - mlockall failed", std::strerror(errno));
+                    return false;
+                }
+                log::info("warmup - memory locked");
+                return true;
+            }
+
+            // replay synthetic traffic through parse, book and extract of a throwaway feeder/book pair built
+            // like the real ones; code, branch history and allocator free lists stay warm once they are gone.
+            // Logging is muted meanwhile.
+            static auto prime(feed::feeder_file* pfeeder, order_book::manager* pbook,
+                    std::vector<reference::instrument_spec> specs, uint32_t events) {
+                if(specs.empty()) {
+                    specs.push_back({ 1, 0.0, 0.0, 0.0, 0 });
+                }
+
+                auto sev = log::level();
+                log::init(4);
+
+                pfeeder->register_observer(pbook);
+
+                std::vector<double> rates; // ns per event of each batch
+                auto start = std::chrono::steady_clock::now();
+                auto batch_start = start;
+                char line[128];
+                for(auto i = 0U; i < events; i ++) {
+                    make(line, sizeof(line), specs[(i / 10) % specs.size()], i);
+                    pfeeder->replay(line, i + 1);
+
+                    if(batch - 1 == i % batch) {
+                        auto now = std::chrono::steady_clock::now();
+                        rates.push_back(std::chrono::duration<double, std::nano>(now - batch_start).count() / batch);
+                        batch_start = now;
+                    }
+                }
+                pbook->flush();
+                auto elapsed = std::chrono::steady_clock::now() - start;
+
+                log::init(sev);
+                report(events, elapsed, rates);
+            }
+
+        private:
+            // groups of 4 orders around a mid price: added, traded against, amended and cancelled away again
+            static auto make(char* line, size_t size, reference::instrument_spec const& spec, uint32_t i) -> void {
+                auto step = spec.tick > 0.0 ? spec.tick : 0.01;
+                auto mid = spec.min_prc > 0.0 ? spec.min_prc + 10 * step : 100.0;
+                auto group = i / 10;
+                auto lev = 1 + group % 5;
+                auto bid = mid - lev * step, ask = mid + lev * step;
+                auto oid = group * 4 + 1;
+                auto qty = 10 * lev;
+
+                switch(i % 10) {
+                case 0: std::snprintf(line, size, "N,%u,%u,B,%u,%.6f", spec.iid, oid, qty, bid); break;
+                case 1: std::snprintf(line, size, "N,%u,%u,S,%u,%.6f", spec.iid, oid + 1, qty, ask); break;
+                case 2: std::snprintf(line, size, "N,%u,%u,B,%u,%.6f", spec.iid, oid + 2, qty, bid); break;
+                case 3: std::snprintf(line, size, "N,%u,%u,S,%u,%.6f", spec.iid, oid + 3, qty, ask); break;
+                case 4: std::snprintf(line, size, "X,%u,%u,%.6f", spec.iid, lev, bid); break;
+                case 5: std::snprintf(line, size, "M,%u,B,0,%.6f", oid, bid); break;
+                case 6: std::snprintf(line, size, "R,%u,S,%u,%.6f", oid + 1, qty, ask); break;
+                case 7: std::snprintf(line, size, "M,%u,B,%u,%.6f", oid + 2, qty / 2, bid); break;
+                case 8: std::snprintf(line, size, "R,%u,B,%u,%.6f", oid + 2, qty / 2, bid); break;
+                default: std::snprintf(line, size, "R,%u,S,%u,%.6f", oid + 3, qty, ask); break;
+                }
+            }
+
+            // steady once a batch is within 20% of the median of the last quarter
+            template<typename D>
+            static auto report(uint32_t events, D elapsed, std::vector<double> const& rates) -> void {
+                auto total_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+                if(rates.size() < 4) {
+                    log::info("warmup -", events, "events in", total_us, "us");
+                    return;
+                }
+
+                std::vector<double> tail(rates.end() - rates.size() / 4, rates.end());
+                std::nth_element(tail.begin(), tail.begin() + tail.size() / 2, tail.end());
+                auto steady = tail[tail.size() / 2];
+
+                auto settled = 0U;
+                auto settled_ns = 0.0;
+                for(auto i = 0U; i < rates.size(); i ++) {
+                    if(rates[i] <= steady * 1.2) {
+                        settled = i;
+                        break;
+                    }
+                    settled_ns += rates[i] * batch;
+                }
+
+                log::info("warmup -", events, "events in", total_us, "us, first", (uint64_t)rates.front(),
+                        "ns/event, steady", (uint64_t)steady, "ns/event after", settled * batch, "events",
+                        (uint64_t)(settled_ns / 1000), "us");
+            }
+    };
+
+}
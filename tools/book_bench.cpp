@@ -0,0 +1,183 @@
+
+// Book storage benchmark: drives a map and a flat book through the same random adds and cancels for several depth
+// profiles, checks both publish the same snapshots and times the updates and the extracts of each.
+//
+//   toy_book_bench [--profiles a,b] [--ops N] [--seed S]
+//     dense    20 levels a side, every tick priced
+//     deep     2000 levels a side, every tick priced
+//     sparse   50 levels a side, spread over 100000 ticks
+
+#include <cstring>
+#include <map>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+
+#include "log.hpp"
+#include "order_book/book.hpp"
+
+using namespace toy;
+using reference::order_side;
+
+struct profile {
+    uint32_t levels;    // prices a side
+    uint32_t spread;    // ticks the prices of a side are drawn from
+};
+
+static std::map<std::string, profile> const profiles {
+    { "dense", { 20, 20 } },
+    { "deep", { 2000, 2000 } },
+    { "sparse", { 50, 100000 } },
+};
+
+static uint32_t const max_lev = 10;
+static double const tick = 0.01;
+
+struct op {
+    bool add;
+    order_side side;
+    int64_t qty;
+    double prc;
+};
+
+// each side gets the profile's levels at random ticks away from 1000.00, then orders come and go on those
+// prices, the busier ones closer to the top; a cancel takes off at most what rests at its price
+auto generate(profile const& p, uint32_t count, std::mt19937& rnd) {
+    std::vector<op> ops;
+    std::vector<double> prices[2];
+    std::map<double, int64_t> resting;
+    for(auto s = 0; s < 2; s ++) {
+        std::vector<bool> used(p.spread);
+        while(prices[s].size() < p.levels) {
+            auto t = rnd() % p.spread;
+            if(!used[t]) {
+                used[t] = true;
+                prices[s].push_back(s ? 1000.0 + (t + 1) * tick : 1000.0 - (t + 1) * tick);
+            }
+        }
+        std::sort(prices[s].begin(), prices[s].end(), [s](double l, double r) { return s ? l < r : l > r; });
+        for(auto prc : prices[s]) {
+            ops.push_back({ true, s ? order_side::sell : order_side::buy, 100, prc });
+            resting[prc] += 100;
+        }
+    }
+
+    std::geometric_distribution<uint32_t> near(8.0 / p.levels);
+    while(ops.size() < count) {
+        auto s = rnd() % 2;
+        auto prc = prices[s][std::min((uint32_t)prices[s].size() - 1, near(rnd))];
+        auto qty = 1 + (int64_t)(rnd() % 100);
+        if(rnd() % 2) {
+            ops.push_back({ true, s ? order_side::sell : order_side::buy, qty, prc });
+            resting[prc] += qty;
+        }
+        else if(resting[prc] > 0) {
+            qty = std::min(qty, resting[prc]);
+            ops.push_back({ false, s ? order_side::sell : order_side::buy, qty, prc });
+            resting[prc] -= qty;
+        }
+    }
+    return ops;
+}
+
+struct result {
+    double update_ns;
+    double extract_ns;
+    std::vector<uint64_t> published;    // quantities and prices of every snapshot, prices bitwise
+};
+
+template<typename BOOK>
+auto run(std::vector<op> const& ops) {
+    BOOK b(1, tick);
+    std::unique_ptr<reference::market> pmkt(reference::make_market_factory(max_lev)(1, max_lev));
+    result r { 0.0, 0.0, {} };
+
+    // one extract every 16 updates, timed apart
+    auto update = std::chrono::steady_clock::duration::zero(), extract = update;
+    auto extracts = 0U;
+    for(auto i = 0U; i < ops.size(); i += 16) {
+        auto start = std::chrono::steady_clock::now();
+        for(auto j = i; j < std::min(i + 16, (uint32_t)ops.size()); j ++) {
+            auto const& o = ops[j];
+            if(o.add) b.add(o.side, o.qty, o.prc);
+            else b.can(o.side, o.qty, o.prc);
+        }
+        auto mid = std::chrono::steady_clock::now();
+        b.try_extract(pmkt.get());
+        extract += std::chrono::steady_clock::now() - mid;
+        update += mid - start;
+        extracts ++;
+
+        for(auto lev = 0U; lev < max_lev; lev ++) {
+            double prc[] = { pmkt->bid_prc(lev), pmkt->ask_prc(lev) };
+            uint64_t bits[2];
+            std::memcpy(bits, prc, sizeof(bits));
+            r.published.push_back(pmkt->bid_qty(lev));
+            r.published.push_back(pmkt->ask_qty(lev));
+            r.published.push_back(bits[0]);
+            r.published.push_back(bits[1]);
+        }
+    }
+    r.update_ns = std::chrono::duration<double, std::nano>(update).count() / ops.size();
+    r.extract_ns = std::chrono::duration<double, std::nano>(extract).count() / extracts;
+    return r;
+}
+
+auto run(std::string const& name, profile const& p, uint32_t count, uint32_t seed) {
+    std::mt19937 rnd(seed);
+    auto ops = generate(p, count, rnd);
+
+    auto map = run<order_book::book>(ops);
+    auto flat = run<order_book::flat_book>(ops);
+    if(map.published != flat.published) {
+        std::cout << "MISMATCH profile " << name << std::endl;
+        return false;
+    }
+
+    std::cout << name << " levels " << p.levels << " over " << p.spread << " ticks: update map "
+        << (uint64_t)map.update_ns << " ns flat " << (uint64_t)flat.update_ns << " ns, extract map "
+        << (uint64_t)map.extract_ns << " ns flat " << (uint64_t)flat.extract_ns << " ns" << std::endl;
+    return true;
+}
+
+auto main(int32_t argc, char** argv) -> int32_t {
+    log::init(4);
+
+    std::vector<std::string> names { "dense", "deep", "sparse" };
+    auto ops = 1000000U, seed = 1U;
+    for(auto i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        auto next = [&]() { return i + 1 < argc ? std::string(argv[++ i]) : std::string(); };
+
+        if(arg == "--ops") ops = std::atoi(next().c_str());
+        else if(arg == "--seed") seed = std::atoi(next().c_str());
+        else if(arg == "--profiles") {
+            names.clear();
+            std::istringstream s(next());
+            std::string name;
+            while(std::getline(s, name, ',')) {
+                names.push_back(name);
+            }
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--profiles a,b] [--ops N] [--seed S]" << std::endl;
+            return 1;
+        }
+    }
+
+    for(auto const& name : names) {
+        if(!profiles.count(name)) {
+            std::cerr << "unknown profile " << name << std::endl;
+            return 1;
+        }
+        if(!run(name, profiles.at(name), ops, seed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+
+// Depth query benchmark: fills one book with random levels, then checks the ladder answers of depth_through
+// and fill_price against a linear scan of the levels and times both, for books of growing depth.
+//
+//   toy_depth_bench [--levels N,N,..] [--queries N] [--seed S]
+
+#include <string>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+
+#include "log.hpp"
+#include "order_book/book.hpp"
+
+using namespace toy;
+using reference::order_side;
+
+struct query {
+    order_side side;
+    double prc;
+    int64_t qty;
+};
+
+// levels on each side of 1000.00, about a fifth of them emptied again by cancels
+auto fill(order_book::book& b, uint32_t levels, std::mt19937& rnd) {
+    auto total = (int64_t)0;
+    for(auto i = 0U; i < levels; i ++) {
+        auto qty = 1 + (int64_t)(rnd() % 100);
+        b.add(order_side::buy, qty, 1000.0 - (i + 1) * 0.01);
+        b.add(order_side::sell, qty, 1000.0 + (i + 1) * 0.01);
+        if(!(rnd() % 5)) {
+            b.can(order_side::buy, qty, 1000.0 - (i + 1) * 0.01);
+            b.can(order_side::sell, qty, 1000.0 + (i + 1) * 0.01);
+        }
+        else {
+            total += qty;
+        }
+    }
+    return total;
+}
+
+template<typename F>
+auto time(std::vector<query> const& queries, F f) {
+    auto sum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for(auto const& q : queries) {
+        sum += f(q);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return std::make_pair(ns / queries.size(), sum);
+}
+
+auto run(uint32_t levels, uint32_t count, uint32_t seed) {
+    std::mt19937 rnd(seed);
+    order_book::book b(1, 0.01);
+    auto total = fill(b, levels, rnd);
+
+    std::vector<query> queries;
+    for(auto i = 0U; i < count; i ++) {
+        auto side = rnd() % 2 ? order_side::buy : order_side::sell;
+        auto off = (1 + (int32_t)(rnd() % levels)) * 0.01;
+        queries.push_back({ side, order_side::buy == side ? 1000.0 - off : 1000.0 + off,
+                1 + (int64_t)(rnd() % (total + total / 10 + 1)) });
+    }
+
+    for(auto const& q : queries) {
+        if(b.depth_through(q.side, q.prc) != b.scan_through(q.side, q.prc)
+                || b.fill_price(q.side, q.qty) != b.scan_fill_price(q.side, q.qty)) {
+            std::cout << "MISMATCH levels " << levels << " side " << (order_side::buy == q.side ? 'B' : 'S')
+                << " prc " << q.prc << " qty " << q.qty << ": through " << b.depth_through(q.side, q.prc)
+                << " vs " << b.scan_through(q.side, q.prc) << ", fill_price " << b.fill_price(q.side, q.qty)
+                << " vs " << b.scan_fill_price(q.side, q.qty) << std::endl;
+            return false;
+        }
+    }
+
+    auto through = time(queries, [&](query const& q) { return (double)b.depth_through(q.side, q.prc); });
+    auto scan_through = time(queries, [&](query const& q) { return (double)b.scan_through(q.side, q.prc); });
+    auto price = time(queries, [&](query const& q) { return b.fill_price(q.side, q.qty); });
+    auto scan_price = time(queries, [&](query const& q) { return b.scan_fill_price(q.side, q.qty); });
+
+    std::cout << "levels " << levels
+        << " through " << (uint64_t)through.first << " ns scan " << (uint64_t)scan_through.first << " ns"
+        << " fill_price " << (uint64_t)price.first << " ns scan " << (uint64_t)scan_price.first << " ns"
+        << std::endl;
+    return through.second == scan_through.second && price.second == scan_price.second;
+}
+
+auto main(int32_t argc, char** argv) -> int32_t {
+    log::init(4);
+
+    std::vector<uint32_t> levels { 10, 100, 1000, 10000 };
+    auto queries = 100000U, seed = 1U;
+    for(auto i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        auto next = [&]() { return i + 1 < argc ? std::string(argv[++ i]) : std::string(); };
+
+        if(arg == "--queries") queries = std::atoi(next().c_str());
+        else if(arg == "--seed") seed = std::atoi(next().c_str());
+        else if(arg == "--levels") {
+            levels.clear();
+            std::istringstream s(next());
+            std::string n;
+            while(std::getline(s, n, ',')) {
+                levels.push_back(std::atoi(n.c_str()));
+            }
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--levels N,N,..] [--queries N] [--seed S]" << std::endl;
+            return 1;
+        }
+    }
+
+    for(auto n : levels) {
+        if(!n || !queries || !run(n, queries, seed)) {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,169 @@
+
+// Subscription filter benchmark: generates a tape over many instruments, replays it unfiltered and subscribed to
+// growing sets of instruments, checks every subscribed instrument publishes what it does unfiltered and nothing
+// else is published, then times each replay.
+//
+//   toy_filter_bench [--lines N] [--instruments N] [--subscribe N,N,..] [--seed S]
+//     subscribed sets are instruments 1..N of each size, default 1,10,100 and all
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <random>
+#include <sstream>
+#include <chrono>
+#include <iostream>
+#include <functional>
+
+#include "log.hpp"
+#include "engine.hpp"
+
+using namespace toy;
+
+// adds, cancels and amends of live orders and executions, some cancels and amends ahead of their add, nothing
+// malformed
+auto generate(uint32_t lines, uint32_t instruments, uint32_t seed) {
+    std::mt19937 rnd(seed);
+    std::vector<std::string> tape;
+    struct live { uint32_t id; uint32_t iid; char side; int64_t qty; double prc; };
+    std::vector<live> orders;
+    std::vector<std::pair<live, bool>> early; // orders whose cancel or amend went out first, true if cancelled
+    uint32_t oid = 1;
+
+    for(auto i = 0U; i < lines; i ++) {
+        std::ostringstream s;
+        auto r = rnd() % 100;
+        if(!early.empty() && r < 5) {
+            auto o = early.back().first;
+            auto cancelled = early.back().second;
+            early.pop_back();
+            s << "N," << o.iid << ',' << o.id << ',' << o.side << ',' << o.qty << ',' << o.prc;
+            if(!cancelled) {
+                o.qty = o.qty / 2;
+                orders.push_back(o);
+            }
+        }
+        else if(r < 45 || orders.empty()) {
+            live o { oid ++, 1 + (uint32_t)(rnd() % instruments), rnd() % 2 ? 'B' : 'S', 2 + (int64_t)(rnd() % 50), 0.0 };
+            o.prc = 100 + ('B' == o.side ? -1 : 1) * (1 + (int32_t)(rnd() % 15)) * 0.5;
+            if(r < 10) {
+                auto cancelled = r < 7;
+                if(cancelled) s << "R," << o.id << ',' << o.side << ',' << o.qty << ',' << o.prc;
+                else s << "M," << o.id << ',' << o.side << ',' << o.qty / 2 << ',' << o.prc;
+                early.push_back({ o, cancelled });
+            }
+            else {
+                s << "N," << o.iid << ',' << o.id << ',' << o.side << ',' << o.qty << ',' << o.prc;
+                orders.push_back(o);
+            }
+        }
+        else if(r < 90) {
+            auto n = rnd() % orders.size();
+            auto& o = orders[n];
+            auto qty = r < 70 || o.qty < 2 ? 0 : o.qty / 2;
+            if(!qty) {
+                s << "R," << o.id << ',' << o.side << ',' << o.qty << ',' << o.prc;
+                o = orders.back();
+                orders.pop_back();
+            }
+            else {
+                s << "M," << o.id << ',' << o.side << ',' << qty << ',' << o.prc;
+                o.qty = qty;
+            }
+        }
+        else {
+            s << "X," << 1 + rnd() % instruments << ',' << 1 + rnd() % 20 << ',' << 100 + (int32_t)(rnd() % 5) - 2;
+        }
+        tape.push_back(s.str());
+    }
+    return tape;
+}
+
+// what each instrument publishes, folded into one hash per instrument
+auto digest(std::vector<std::string> const& tape, engine_options const& opt, uint32_t instruments) {
+    std::vector<size_t> hashes(instruments + 1);
+    std::unique_ptr<engine> peng(engine::make(opt));
+    peng->on_snapshot([&](reference::market const* pmkt) {
+        std::ostringstream s;
+        s << pmkt;
+        auto& h = hashes[pmkt->iid() <= instruments ? pmkt->iid() : 0];
+        h = h * 31 + std::hash<std::string>()(s.str()) + 1;
+    });
+    for(auto const& line : tape) {
+        peng->push(line);
+    }
+    peng->flush();
+    return hashes;
+}
+
+// lines per second and lines filtered
+auto measure(std::vector<std::string> const& tape, engine_options const& opt) {
+    std::unique_ptr<engine> peng(engine::make(opt));
+    auto start = std::chrono::steady_clock::now();
+    for(auto const& line : tape) {
+        peng->push(line);
+    }
+    peng->flush();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return std::make_pair(tape.size() / elapsed, peng->filtered());
+}
+
+auto main(int32_t argc, char** argv) -> int32_t {
+    log::init(4); // engines log every snapshot
+
+    auto lines = 1000000U, instruments = 1000U, seed = 1U;
+    std::vector<uint32_t> sizes;
+    for(auto i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        auto next = [&]() { return i + 1 < argc ? std::string(argv[++ i]) : std::string(); };
+
+        if(arg == "--lines") lines = std::atoi(next().c_str());
+        else if(arg == "--instruments") instruments = std::max(std::atoi(next().c_str()), 1);
+        else if(arg == "--seed") seed = std::atoi(next().c_str());
+        else if(arg == "--subscribe") {
+            std::istringstream s(next());
+            std::string n;
+            while(std::getline(s, n, ',')) {
+                sizes.push_back(std::atoi(n.c_str()));
+            }
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--lines N] [--instruments N] [--subscribe N,N,..] [--seed S]"
+                << std::endl;
+            return 1;
+        }
+    }
+    if(sizes.empty()) {
+        sizes = { 1, 10, 100, instruments };
+    }
+
+    auto tape = generate(lines, instruments, seed);
+
+    engine_options opt;
+    auto all = digest(tape, opt, instruments);
+    auto base = measure(tape, opt);
+    std::cout << "unfiltered " << instruments << " instruments " << (uint64_t)base.first << " lines/s" << std::endl;
+
+    for(auto size : sizes) {
+        if(!size || size > instruments) {
+            std::cerr << "subscribed sets must be of 1 to " << instruments << " instruments" << std::endl;
+            return 1;
+        }
+
+        auto filtered_opt = opt;
+        filtered_opt.subscription.push_back({ 1, size });
+
+        auto some = digest(tape, filtered_opt, instruments);
+        for(auto iid = 0U; iid <= instruments; iid ++) {
+            if(some[iid] != (iid && iid <= size ? all[iid] : 0)) {
+                std::cout << "MISMATCH subscribed to " << size << " at instrument " << iid << std::endl;
+                return 1;
+            }
+        }
+
+        auto rate = measure(tape, filtered_opt);
+        std::cout << "subscribed " << size << " of " << instruments << ' ' << (uint64_t)rate.first << " lines/s "
+            << rate.first / base.first << "x, " << rate.second << " lines filtered" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,279 @@
+
+// ITCH-like capture converter and benchmark. Converts a tape to a binary capture, checks that replaying the
+// capture publishes exactly what replaying the tape does, then times decoding alone and both replays end to end.
+//
+//   toy_itch_bench --convert <tape.csv> <capture.itch>
+//   toy_itch_bench [--repeat N] <tape.csv | --generate N>
+//     --seed S           generator seed (default 1)
+//     --repeat N         passes over the capture for the decode-only timing (default 20)
+//
+// Lines that cannot be encoded (comments, parse errors, iid over 65535, prices off the 0.0001 grid) are
+// left out of the capture and of the comparison.
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <iostream>
+
+#include "log.hpp"
+#include "engine.hpp"
+#include "src/feed/feeder_file.hpp"
+
+using namespace toy;
+using reference::order_action;
+using reference::order_side;
+
+// one tape line to a message, false if it has none
+auto encode(std::string const& line, feed::itch::encoder& enc) {
+    if(line.empty() || '#' == line[0]) {
+        return false;
+    }
+
+    auto str = line.c_str();
+    auto valid = true;
+    auto ts_ns = feed::extract_ts(str, valid) * 1000;
+    if(!valid) {
+        return false;
+    }
+
+    auto fits = [](int64_t qty, double prc, int64_t min_qty) {
+        auto ticks = prc * 10000;
+        return qty >= min_qty && qty <= UINT32_MAX && prc > 0.0 && ticks <= UINT32_MAX
+            && std::fabs(ticks - std::llround(ticks)) < 0.000001;
+    };
+
+    auto act = feed::extract_act(str);
+    switch(act) {
+        case order_action::insert: {
+            auto iid = feed::extract_uint(str);
+            auto id = feed::extract_uint(str);
+            auto side = feed::extract_side(str);
+            auto qty = feed::extract_uint(str);
+            auto prc = feed::extract_prc(str);
+            if(iid <= 0 || iid > UINT16_MAX || id <= 0 || order_side::MAX == side || !fits(qty, prc, 1)) {
+                return false;
+            }
+            enc.add(iid, ts_ns, id, side, qty, prc);
+            return true;
+        }
+        case order_action::remove:
+        case order_action::amend: {
+            auto id = feed::extract_uint(str);
+            auto side = feed::extract_side(str);
+            auto qty = feed::extract_uint(str);
+            auto prc = feed::extract_prc(str);
+            if(id <= 0 || order_side::MAX == side || !fits(qty, prc, order_action::remove == act ? 1 : 0)) {
+                return false;
+            }
+            if(order_action::remove == act) {
+                enc.del(ts_ns, id, side, qty, prc);
+            }
+            else {
+                enc.replace(ts_ns, id, side, qty, prc);
+            }
+            return true;
+        }
+        case order_action::match: {
+            auto iid = feed::extract_uint(str);
+            auto qty = feed::extract_uint(str);
+            auto prc = feed::extract_prc(str);
+            if(iid <= 0 || iid > UINT16_MAX || !fits(qty, prc, 1)) {
+                return false;
+            }
+            enc.exe(iid, ts_ns, qty, prc);
+            return true;
+        }
+        default:
+            return false;
+    }
+}
+
+// random valid tape, with cancels and amends of orders not added yet
+auto generate(uint32_t lines, uint32_t seed) {
+    std::mt19937 rnd(seed);
+    std::vector<std::string> tape;
+    struct live { uint32_t iid; char side; int64_t qty; double prc; };
+    std::map<uint32_t, live> orders;
+    uint32_t oid = 1;
+
+    for(auto i = 0U; i < lines; i ++) {
+        std::ostringstream s;
+        auto r = rnd() % 100;
+        if(r < 45 || orders.empty()) {
+            live o { 1 + (uint32_t)(rnd() % 8), rnd() % 2 ? 'B' : 'S', 1 + (int64_t)(rnd() % 50), 0.0 };
+            o.prc = 100 + ('B' == o.side ? -1 : 1) * (1 + (int32_t)(rnd() % 15)) * 0.05;
+            s << "N," << o.iid << ',' << oid << ',' << o.side << ',' << o.qty << ',' << o.prc;
+            orders[oid ++] = o;
+        }
+        else if(r < 90) {
+            auto it = orders.begin();
+            std::advance(it, rnd() % orders.size());
+            auto qty = r < 65 || rnd() % 3 ? 0 : it->second.qty / 2;
+            s << (r < 65 ? "R," : "M,") << it->first << ',' << it->second.side << ','
+                << (r < 65 ? it->second.qty : qty) << ',' << it->second.prc;
+            it->second.qty = qty;
+            if(!qty) {
+                orders.erase(it);
+            }
+        }
+        else if(r < 97) {
+            s << "X," << 1 + rnd() % 8 << ',' << 1 + rnd() % 20 << ',' << 100 + (int32_t)(rnd() % 5) - 2;
+        }
+        else {
+            s << (rnd() % 2 ? "R," : "M,") << oid + 1 + rnd() % 3 << ",B," << 1 + rnd() % 10 << ",99";
+        }
+        tape.push_back(s.str());
+    }
+    return tape;
+}
+
+auto load(std::string const& pathname, std::vector<std::string>& tape) {
+    std::ifstream s(pathname);
+    if(!s.good()) {
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(s, line)) {
+        tape.push_back(line);
+    }
+    return true;
+}
+
+// counts and sums fields, so decoding cannot be optimized away
+struct counter {
+    uint64_t messages = 0;
+    uint64_t bad = 0;
+    double sum = 0.0;
+
+    auto handle(feed::itch::add_order const& m, uint32_t) {
+        messages ++;
+        sum += m.locate() + m.ref() + (uint32_t)m.side() + m.shares() * m.price();
+    }
+    auto handle(feed::itch::delete_order const& m, uint32_t) {
+        messages ++;
+        sum += m.ref() + (uint32_t)m.side() + m.shares() * m.price();
+    }
+    auto handle(feed::itch::replace_order const& m, uint32_t) {
+        messages ++;
+        sum += m.ref() + (uint32_t)m.side() + m.shares() * m.price();
+    }
+    auto handle(feed::itch::execute const& m, uint32_t) {
+        messages ++;
+        sum += m.locate() + m.shares() * m.price();
+    }
+    auto unknown(uint8_t, uint32_t) { bad ++; }
+    auto malformed(uint32_t) { bad ++; }
+};
+
+auto seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// poutput nullptr: snapshots are built but not printed
+auto make_engine(std::string* poutput) {
+    engine_options opt;
+    opt.interval = 1;
+    std::unique_ptr<engine> peng(engine::make(opt));
+    if(poutput) {
+        peng->on_snapshot([poutput](reference::market const* pmkt) {
+            std::ostringstream s;
+            s << pmkt << '\n';
+            *poutput += s.str();
+        });
+    }
+    return peng;
+}
+
+auto main(int32_t argc, char** argv) -> int32_t {
+    log::init(4);
+
+    std::string pathname, converted;
+    auto generated = 0U, seed = 1U, repeat = 20U;
+    for(auto i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        auto next = [&]() { return i + 1 < argc ? std::string(argv[++ i]) : std::string(); };
+
+        if(arg == "--generate") generated = std::atoi(next().c_str());
+        else if(arg == "--seed") seed = std::atoi(next().c_str());
+        else if(arg == "--repeat") repeat = std::max(std::atoi(next().c_str()), 1);
+        else if(arg == "--convert") { pathname = next(); converted = next(); }
+        else pathname = arg;
+    }
+
+    std::vector<std::string> tape;
+    if(generated) {
+        tape = generate(generated, seed);
+    }
+    else if(pathname.empty() || !load(pathname, tape)) {
+        std::cerr << "usage: " << argv[0] << " --convert <tape.csv> <capture.itch>\n"
+            << "       " << argv[0] << " [options] <tape.csv | --generate N>" << std::endl;
+        return 1;
+    }
+
+    std::string capture;
+    feed::itch::encoder enc(capture);
+    std::vector<std::string> lines; // those encoded, in capture order
+    for(auto const& line : tape) {
+        if(encode(line, enc)) {
+            lines.push_back(line);
+        }
+    }
+    std::cout << lines.size() << " of " << tape.size() << " lines encoded, " << capture.size() << " bytes" << std::endl;
+
+    if(!converted.empty()) {
+        std::ofstream s(converted, std::ios::binary);
+        s.write(capture.data(), capture.size());
+        if(!s.good()) {
+            std::cerr << "failed to write " << converted << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // both replays publish the same
+    std::string csv_output, itch_output;
+    auto pcsv = make_engine(&csv_output);
+    auto pitch = make_engine(&itch_output);
+    for(auto const& line : lines) {
+        pcsv->push(line);
+    }
+    if(pitch->decode(capture.data(), capture.size()) != capture.size() || csv_output != itch_output) {
+        std::cout << "MISMATCH between tape and capture replay" << std::endl;
+        return 1;
+    }
+    std::cout << "identical over " << lines.size() << " messages, " << csv_output.size() << " bytes published"
+        << std::endl;
+
+    counter c;
+    auto start = std::chrono::steady_clock::now();
+    for(auto i = 0U; i < repeat; i ++) {
+        auto seq = 0U;
+        feed::itch::decoder<counter>::decode(capture.data(), capture.size(), c, seq);
+    }
+    auto elapsed = seconds_since(start);
+    std::cout << "decode " << (uint64_t)(c.messages / elapsed) << " messages/s "
+        << (uint64_t)(capture.size() * repeat / elapsed / 1000000) << " MB/s "
+        << elapsed * 1000000000 / c.messages << " ns/message (" << c.bad << " bad, sum " << c.sum << ")" << std::endl;
+
+    pcsv = make_engine(nullptr);
+    start = std::chrono::steady_clock::now();
+    for(auto const& line : lines) {
+        pcsv->push(line);
+    }
+    auto csv_rate = lines.size() / seconds_since(start);
+
+    pitch = make_engine(nullptr);
+    start = std::chrono::steady_clock::now();
+    pitch->decode(capture.data(), capture.size());
+    auto itch_rate = lines.size() / seconds_since(start);
+
+    std::cout << "replay csv " << (uint64_t)csv_rate << " messages/s, itch " << (uint64_t)itch_rate
+        << " messages/s " << itch_rate / csv_rate << "x" << std::endl;
+    return 0;
+}
@@ -0,0 +1,74 @@
+
+// Cost of log calls the configuration disables, per call: a debug line with the arguments manager::add logs,
+// one with an argument that is expensive to build, and both again compiled below TOY_LOG_MIN_SEVERITY.
+// Runtime disabled calls should cost a load and a compare, stripped ones nothing over the empty loop.
+//
+//   toy_log_bench [--calls N]
+
+#include <string>
+#include <chrono>
+#include <iostream>
+
+#include "log.hpp"
+#include "reference/order.hpp"
+
+using namespace toy;
+
+static uint64_t built = 0;
+
+// stands for anything formatted for the log only
+auto expensive(uint32_t i) {
+    built ++;
+    return std::to_string(i) + std::string(64, 'x');
+}
+
+template<typename F>
+auto time(char const* name, uint32_t calls, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for(auto i = 0U; i < calls; i ++) {
+        f(i);
+    }
+    auto ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ' ' << ns / calls << " ns/call" << std::endl;
+}
+
+auto runtime(uint32_t calls, reference::order const* po) {
+    time("runtime disabled, order", calls, [po](uint32_t) { TOY_LOG(debug, order_book, "New", po); });
+    time("runtime disabled, expensive", calls, [](uint32_t i) { TOY_LOG(debug, order_book, "New", expensive(i)); });
+    time("runtime disabled, log::debug", calls, [po](uint32_t) { log::debug("New", po); });
+}
+
+#undef TOY_LOG_MIN_SEVERITY
+#define TOY_LOG_MIN_SEVERITY 1
+
+auto stripped(uint32_t calls, reference::order const* po) {
+    time("stripped, order", calls, [po](uint32_t) { TOY_LOG(debug, order_book, "New", po); });
+    time("stripped, expensive", calls, [](uint32_t i) { TOY_LOG(debug, order_book, "New", expensive(i)); });
+}
+
+auto main(int32_t argc, char** argv) -> int32_t {
+    auto calls = 10000000U;
+    for(auto i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        if(arg == "--calls" && i + 1 < argc) {
+            calls = std::atoi(argv[++ i]);
+        }
+        else {
+            std::cerr << "usage: " << argv[0] << " [--calls N]" << std::endl;
+            return 1;
+        }
+    }
+
+    log::init(3);
+    reference::order o {};
+
+    time("empty loop", calls, [](uint32_t) {});
+    runtime(calls, &o);
+    stripped(calls, &o);
+
+    if(built) {
+        std::cout << "expensive arguments built " << built << " times" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+
+// Differential replay: feeds the same tape through the reference engine and candidate engines in lock step,
+// compares error classification and every published snapshot line by line, then measures throughput of each.
+//
+//   toy_replay_diff [options] <tape.csv | --generate N>
+//     --seed S           generator seed (default 1)
+//     --instruments N    generator instrument ids 1..N (default 8)
+//     --strict           feeder_tolerant=false (default tolerant)
+//     --level N          order_book_level (default 5)
+//     --interval N       order_book_interval (default 1)
+//     --tolerance N      order_book_tolerance (default 10)
+//     --engines a,b      candidates to compare against reference (default all)
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <random>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <iostream>
+#include <functional>
+
+#include "log.hpp"
+#include "engine.hpp"
+
+using namespace toy;
+
+using tweak_type = std::function<void(engine_options&)>;
+
+// candidates must publish exactly what the reference publishes
+static std::map<std::string, tweak_type> const candidates {
+    { "l3", [](engine_options& opt) { opt.l3 = true; } },
+    { "flat", [](engine_options& opt) {
+        opt.storage = reference::book_storage::flat;
+        for(auto& spec : opt.instruments) {
+            spec.storage = reference::book_storage::flat;
+        }
+    } },
+};
+
+class runner {
+    public:
+        runner(std::string const& name, engine_options opt, tweak_type const& tweak) : _name(name) {
+            tweak(opt);
+            _peng.reset(engine::make(opt));
+        }
+
+        auto name() const -> std::string const& { return _name; }
+        auto output() const -> std::string const& { return _output; }
+        auto error() const { return _peng->last_error() ? _peng->last_error() : "-"; }
+
+        // record what this line publishes
+        auto record() {
+            _peng->on_snapshot([this](reference::market const* pmkt) {
+                std::ostringstream s;
+                s << pmkt << '\n';
+                _output += s.str();
+            });
+        }
+
+        auto replay(std::string const& line) {
+            _output.clear();
+            _peng->push(line);
+        }
+
+    private:
+        std::string _name;
+        std::unique_ptr<engine> _peng;
+        std::string _output;
+};
+
+// random tape with disorder: cancels/amends before adds, side/price mismatch, garbage lines
+auto generate(uint32_t lines, uint32_t seed, uint32_t instruments) {
+    std::mt19937 rnd(seed);
+    std::vector<std::string> tape;
+    struct live { uint32_t iid; char side; int64_t qty; double prc; };
+    std::map<uint32_t, live> orders;
+    uint32_t oid = 1;
+
+    auto pick = [&]() {
+        auto it = orders.begin();
+        std::advance(it, rnd() % orders.size());
+        return it;
+    };
+
+    for(auto i = 0U; i < lines; i ++) {
+        std::ostringstream s;
+        auto r = rnd() % 100;
+        if(r < 45 || orders.empty()) {
+            live o { 1 + (uint32_t)(rnd() % instruments), rnd() % 2 ? 'B' : 'S', 1 + (int64_t)(rnd() % 50), 0.0 };
+            o.prc = 100 + ('B' == o.side ? -1 : 1) * (1 + (int32_t)(rnd() % 15)) * 0.5;
+            s << "N," << o.iid << ',' << oid << ',' << o.side << ',' << o.qty << ',' << o.prc;
+            orders[oid ++] = o;
+        }
+        else if(r < 65) {
+            auto it = pick();
+            s << "R," << it->first << ',' << it->second.side << ',' << it->second.qty << ',' << it->second.prc;
+            orders.erase(it);
+        }
+        else if(r < 80) {
+            auto it = pick();
+            auto qty = rnd() % 3 ? 0 : it->second.qty / 2;
+            s << "M," << it->first << ',' << it->second.side << ',' << qty << ',' << it->second.prc;
+            it->second.qty = qty;
+            if(!qty) {
+                orders.erase(it);
+            }
+        }
+        else if(r < 90) {
+            s << "X," << 1 + rnd() % instruments << ',' << 1 + rnd() % 20 << ',' << 100 + (int32_t)(rnd() % 5) - 2;
+        }
+        else if(r < 94) { // out of order, cancel or amend for an order not added yet
+            s << (rnd() % 2 ? "R," : "M,") << oid + 1 + rnd() % 3 << ",B," << 1 + rnd() % 10 << ",99";
+        }
+        else if(r < 97 && !orders.empty()) { // inconsistent side / price
+            auto it = pick();
+            s << "R," << it->first << ',' << ('B' == it->second.side ? 'S' : 'B') << ',' << it->second.qty
+                << ',' << it->second.prc + (rnd() % 2 ? 0.5 : 0.0);
+        }
+        else {
+            char const* garbage[] = { "Q,1,2,3", "N,1,abc,B,1,1", "N,1,7,B,0,100", "X,1,5,-1", "M,1,Z,1,1" };
+            s << garbage[rnd() % 5];
+        }
+        tape.push_back(s.str());
+    }
+    return tape;
+}
+
+auto load(std::string const& pathname, std::vector<std::string>& tape) {
+    std::ifstream s(pathname);
+    if(!s.good()) {
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(s, line)) {
+        tape.push_back(line);
+    }
+    return true;
+}
+
+auto make_engines(engine_options const& opt, std::vector<std::string> const& names) {
+    std::vector<std::unique_ptr<runner>> engines;
+    engines.emplace_back(new runner("reference", opt, [](engine_options&) {}));
+    for(auto const& name : names) {
+        engines.emplace_back(new runner(name, opt, candidates.at(name)));
+    }
+    return engines;
+}
+
+auto compare(std::vector<std::string> const& tape, engine_options const& opt, std::vector<std::string> const& names) {
+    auto engines = make_engines(opt, names);
+    for(auto& e : engines) {
+        e->record();
+    }
+
+    std::deque<uint32_t> context;
+    auto snapshots = 0UL;
+    for(auto i = 0U; i < tape.size(); i ++) {
+        auto const& line = tape[i];
+        if(line.empty()) {
+            continue;
+        }
+
+        for(auto& e : engines) {
+            e->replay(line);
+        }
+
+        auto const& ref = *engines.front();
+        snapshots += !ref.output().empty();
+        for(auto& e : engines) {
+            if(e->output() == ref.output() && std::string(e->error()) == ref.error()) {
+                continue;
+            }
+
+            std::cout << "DIVERGENCE at line " << i + 1 << ": " << line << "\n  context:\n";
+            for(auto c : context) {
+                std::cout << "    " << c + 1 << ": " << tape[c] << '\n';
+            }
+            for(auto const* pe : { &ref, (runner const*)e.get() }) {
+                std::cout << "  " << pe->name() << " error " << pe->error() << "\n" << pe->output();
+            }
+            return false;
+        }
+
+        context.push_back(i);
+        if(context.size() > 5) {
+            context.pop_front();
+        }
+    }
+
+    std::cout << "identical over " << tape.size() << " lines, " << snapshots << " snapshots" << std::endl;
+    return true;
+}
+
+auto measure(std::vector<std::string> const& tape, engine_options const& opt, std::vector<std::string> const& names) {
+    auto engines = make_engines(opt, names);
+
+    auto ref_rate = 0.0;
+    for(auto& e : engines) {
+        auto start = std::chrono::steady_clock::now();
+        for(auto i = 0U; i < tape.size(); i ++) {
+            if(!tape[i].empty()) {
+                e->replay(tape[i]);
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        auto rate = tape.size() / elapsed;
+        if(ref_rate <= 0.0) {
+            ref_rate = rate;
+        }
+        std::cout << e->name() << ' ' << (uint64_t)rate << " lines/s " << rate / ref_rate << "x" << std::endl;
+    }
+}
+
+auto main(int32_t argc, char** argv) -> int32_t {
+    log::init(4); // engines log a lot, keep them quiet
+
+    engine_options opt;
+    opt.interval = 1;
+    std::vector<std::string> names;
+    for(auto const& c : candidates) {
+        names.push_back(c.first);
+    }
+
+    std::string pathname;
+    auto generated = 0U, seed = 1U, instruments = 8U;
+    for(auto i = 1; i < argc; i ++) {
+        std::string arg = argv[i];
+        auto next = [&]() { return i + 1 < argc ? std::string(argv[++ i]) : std::string(); };
+
+        if(arg == "--generate") generated = std::atoi(next().c_str());
+        else if(arg == "--seed") seed = std::atoi(next().c_str());
+        else if(arg == "--instruments") instruments = std::max(std::atoi(next().c_str()), 1);
+        else if(arg == "--strict") opt.tolerant = false;
+        else if(arg == "--level") opt.max_lev = std::atoi(next().c_str());
+        else if(arg == "--interval") opt.interval = std::atoi(next().c_str());
+        else if(arg == "--tolerance") opt.tolerance = std::atoi(next().c_str());
+        else if(arg == "--engines") {
+            names.clear();
+            std::istringstream s(next());
+            std::string name;
+            while(std::getline(s, name, ',')) {
+                if(!candidates.count(name)) {
+                    std::cerr << "unknown engine " << name << std::endl;
+                    return 1;
+                }
+                names.push_back(name);
+            }
+        }
+        else pathname = arg;
+    }
+
+    std::vector<std::string> tape;
+    if(generated) {
+        tape = generate(generated, seed, instruments);
+    }
+    else if(pathname.empty() || !load(pathname, tape)) {
+        std::cerr << "usage: " << argv[0] << " [options] <tape.csv | --generate N>" << std::endl;
+        return 1;
+    }
+
+    if(!std::unique_ptr<engine>(engine::make(opt))) {
+        std::cerr << "invalid options" << std::endl;
+        return 1;
+    }
+
+    if(!compare(tape, opt, names)) {
+        return 1;
+    }
+
+    measure(tape, opt, names);
+    return 0;
+}